@@ -15,6 +15,8 @@ class PitchShiftSource {
   virtual void setTimeRatio(double time_ratio) = 0;
   virtual void setPitchScale(double pitch_scale) = 0;
   virtual size_t retrieve(uintptr_t output_ptr) = 0;
+  virtual size_t seek(size_t output_frame) = 0;
+  [[nodiscard]] virtual size_t getPosition() const = 0;
   [[nodiscard]] virtual size_t getInputSize() const = 0;
   [[nodiscard]] virtual size_t getOutputSize() const = 0;
   virtual size_t getSamplesAvailable() = 0;
@@ -0,0 +1,36 @@
+//
+// Small timing helpers shared by the benchmark suites.
+//
+
+#ifndef WASM_SRC_BENCHMARK_BENCHMARK_H_
+#define WASM_SRC_BENCHMARK_BENCHMARK_H_
+
+#include <chrono>
+#include <cstddef>
+
+// Runs fn iterations times and returns the mean duration of a single run in microseconds
+template<typename Function>
+double measure(Function fn, size_t iterations) {
+  const auto begin = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    fn();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - begin).count() / static_cast<double>(iterations);
+}
+
+void runEngineBenchmark();
+
+void runInterleaveBenchmark();
+
+void runLatencyBenchmark();
+
+void runOfflineBenchmark();
+
+void runParallelBenchmark();
+
+void runSanitizeBenchmark();
+
+void runThreadingBenchmark();
+
+#endif //WASM_SRC_BENCHMARK_BENCHMARK_H_
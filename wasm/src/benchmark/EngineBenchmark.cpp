@@ -0,0 +1,100 @@
+//
+// Realtime factor of both Rubber Band engines in offline and realtime mode, 10 s of 48 kHz stereo stretched by
+// 1.25 and pitched by 1.1. Run the baseline and the SIMD wasm builds under node to compare them per engine.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <RubberBandStretcher.h>
+#include "Benchmark.h"
+
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kChannelCount = 2;
+const size_t kSeconds = 10;
+const size_t kBlockSize = 512;
+const double kTimeRatio = 1.25;
+const double kPitchScale = 1.1;
+
+const char *getBuildName() {
+#if defined(__wasm_simd128__)
+  return "wasm simd128";
+#elif defined(__EMSCRIPTEN__)
+  return "wasm baseline";
+#else
+  return "native";
+#endif
+}
+
+// Stretches the whole input a block at a time (studying it first offline), returns the duration in milliseconds
+double stretch(const std::vector<std::vector<float>> &input, RubberBand::RubberBandStretcher::Options options) {
+  const size_t frame_count = input[0].size();
+  const bool offline = !(options & RubberBand::RubberBandStretcher::OptionProcessRealTime);
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(kBlockSize * 4));
+  std::vector<const float *> input_channels(kChannelCount);
+  std::vector<float *> output_channels(kChannelCount);
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    output_channels[channel] = output[channel].data();
+  }
+
+  return measure([&]() {
+    RubberBand::RubberBandStretcher stretcher(kSampleRate, kChannelCount, options, kTimeRatio, kPitchScale);
+    stretcher.setMaxProcessSize(kBlockSize);
+    for (int pass = offline ? 0 : 1; pass < 2; ++pass) {
+      for (size_t offset = 0; offset < frame_count; offset += kBlockSize) {
+        const size_t frames = std::min(kBlockSize, frame_count - offset);
+        const bool final = offset + frames >= frame_count;
+        for (size_t channel = 0; channel < kChannelCount; ++channel) {
+          input_channels[channel] = input[channel].data() + offset;
+        }
+        if (pass == 0) {
+          stretcher.study(input_channels.data(), frames, final);
+          continue;
+        }
+        stretcher.process(input_channels.data(), frames, final);
+        int available;
+        while ((available = stretcher.available()) > 0) {
+          stretcher.retrieve(output_channels.data(), std::min<size_t>(available, kBlockSize * 4));
+        }
+      }
+    }
+  }, 1) / 1e3;
+}
+
+}  // namespace
+
+void runEngineBenchmark() {
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(kSampleRate * kSeconds));
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < input[channel].size(); ++i) {
+      const double t = static_cast<double>(i) / kSampleRate;
+      input[channel][i] = static_cast<float>(0.3 * std::sin(2.0 * M_PI * 220.0 * t) +
+          0.2 * std::sin(2.0 * M_PI * (554.0 + 110.0 * channel) * t));
+    }
+  }
+
+  using Stretcher = RubberBand::RubberBandStretcher;
+  struct Engine {
+    const char *name;
+    Stretcher::Options options;
+  };
+  const Engine engines[] = {
+      {"R2 offline", Stretcher::OptionProcessOffline | Stretcher::OptionEngineFaster},
+      {"R3 offline", Stretcher::OptionProcessOffline | Stretcher::OptionEngineFiner},
+      {"R2 realtime", Stretcher::OptionProcessRealTime | Stretcher::OptionEngineFaster},
+      {"R3 realtime", Stretcher::OptionProcessRealTime | Stretcher::OptionEngineFiner},
+  };
+
+  std::cout << "build: " << getBuildName() << ", " << kSeconds << " s of stereo" << std::endl;
+  std::cout << "engine      | time (ms) | realtime factor" << std::endl;
+  for (const auto &engine : engines) {
+    const double milliseconds = stretch(input, engine.options);
+    std::cout << std::left << std::setw(11) << engine.name << std::right << " | "
+              << std::setw(9) << std::fixed << std::setprecision(0) << milliseconds << " | "
+              << std::setw(14) << std::setprecision(1) << kSeconds * 1e3 / milliseconds << "x" << std::endl;
+  }
+}
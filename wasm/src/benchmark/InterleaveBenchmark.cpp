@@ -0,0 +1,125 @@
+//
+// Compares the interleave kernels with the scalar loops they replaced in RealtimeRubberBand::process(), and the
+// fused int16 conversion with converting to interleaved float first and deinterleaving after.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include "Benchmark.h"
+#include "../rubberband/Interleave.h"
+#include "../rubberband/PcmConversion.h"
+
+// What process() used to do: a modulo per frame and a sample at a time
+static void deinterleaveModulo(const float *ring, size_t ring_size, size_t position,
+                               float *const *destination, size_t channel_count, size_t frame_count) {
+  for (size_t i = 0; i < frame_count; ++i) {
+    const size_t index = ((position + i) % ring_size) * channel_count;
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      destination[channel][i] = ring[index + channel];
+    }
+  }
+}
+
+static void interleaveModulo(const float *const *source, float *ring, size_t ring_size, size_t position,
+                             size_t channel_count, size_t frame_count) {
+  for (size_t i = 0; i < frame_count; ++i) {
+    const size_t index = ((position + i) % ring_size) * channel_count;
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      ring[index + channel] = source[channel][i];
+    }
+  }
+}
+
+void runInterleaveBenchmark() {
+  const size_t kBlockSize = 512;
+  const size_t kRingSize = 16384;
+  const size_t kIterations = 20000;
+  volatile float sink = 0;
+
+  std::cout << "kernel: " << getInterleaveKernelName() << ", block size " << kBlockSize << std::endl;
+  std::cout << "channels | modulo (us) | scalar (us) | kernel (us) | speedup vs modulo" << std::endl;
+  for (size_t channel_count : {1, 2, 4, 6, 8}) {
+    std::vector<float> ring(kRingSize * channel_count);
+    for (size_t i = 0; i < ring.size(); ++i) {
+      ring[i] = static_cast<float>(i % 1000) / 1000.0f;
+    }
+    std::vector<std::vector<float>> planar(channel_count, std::vector<float>(kBlockSize));
+    std::vector<float *> channels(channel_count);
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      channels[channel] = planar[channel].data();
+    }
+
+    size_t position = 0;
+    const auto advance = [&]() {
+      position = (position + kBlockSize + 3) % (kRingSize - kBlockSize);
+    };
+    const double modulo = measure([&]() {
+      deinterleaveModulo(ring.data(), kRingSize, position, channels.data(), channel_count, kBlockSize);
+      interleaveModulo(channels.data(), ring.data(), kRingSize, position, channel_count, kBlockSize);
+      advance();
+    }, kIterations);
+    const double scalar = measure([&]() {
+      deinterleaveScalar(ring.data() + position * channel_count, channels.data(), 0, channel_count, kBlockSize);
+      interleaveScalar(channels.data(), 0, ring.data() + position * channel_count, channel_count, kBlockSize);
+      advance();
+    }, kIterations);
+    const double kernel = measure([&]() {
+      deinterleave(ring.data() + position * channel_count, channels.data(), 0, channel_count, kBlockSize);
+      interleave(channels.data(), 0, ring.data() + position * channel_count, channel_count, kBlockSize);
+      advance();
+    }, kIterations);
+    sink = sink + ring[position];
+
+    std::cout << std::setw(8) << channel_count << " | "
+              << std::setw(11) << std::fixed << std::setprecision(3) << modulo << " | "
+              << std::setw(11) << scalar << " | "
+              << std::setw(11) << kernel << " | "
+              << std::setprecision(2) << modulo / kernel << "x" << std::endl;
+  }
+
+  std::cout << "int16 in and out, channels | two pass (us) | fused scalar (us) | fused kernel (us) | speedup" << std::endl;
+  for (size_t channel_count : {1, 2, 6}) {
+    std::vector<int16_t> pcm(kBlockSize * channel_count);
+    for (size_t i = 0; i < pcm.size(); ++i) {
+      pcm[i] = static_cast<int16_t>(i * 37);
+    }
+    std::vector<float> interleaved(kBlockSize * channel_count);
+    std::vector<std::vector<float>> planar(channel_count, std::vector<float>(kBlockSize));
+    std::vector<float *> channels(channel_count);
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      channels[channel] = planar[channel].data();
+    }
+
+    // What callers had to do before: convert to interleaved float, then deinterleave (and the reverse)
+    const double two_pass = measure([&]() {
+      for (size_t i = 0; i < pcm.size(); ++i) {
+        interleaved[i] = static_cast<float>(pcm[i]) / 32768.0f;
+      }
+      deinterleave(interleaved.data(), channels.data(), 0, channel_count, kBlockSize);
+      interleave(channels.data(), 0, interleaved.data(), channel_count, kBlockSize);
+      for (size_t i = 0; i < pcm.size(); ++i) {
+        const float sample = std::min(std::max(interleaved[i], -1.0f), 1.0f) * 32768.0f;
+        pcm[i] = static_cast<int16_t>(std::min(std::lrint(sample), 32767L));
+      }
+    }, kIterations);
+    const double scalar = measure([&]() {
+      deinterleavePcmScalar(pcm.data(), SampleFormat::kInt16, channels.data(), 0, channel_count, kBlockSize);
+      interleavePcmScalar(channels.data(), 0, pcm.data(), SampleFormat::kInt16, channel_count, kBlockSize);
+    }, kIterations);
+    const double kernel = measure([&]() {
+      deinterleavePcm(pcm.data(), SampleFormat::kInt16, channels.data(), 0, channel_count, kBlockSize);
+      interleavePcm(channels.data(), 0, pcm.data(), SampleFormat::kInt16, channel_count, kBlockSize);
+    }, kIterations);
+    sink = sink + planar[0][1];
+
+    std::cout << std::setw(26) << channel_count << " | "
+              << std::setw(13) << std::fixed << std::setprecision(3) << two_pass << " | "
+              << std::setw(17) << scalar << " | "
+              << std::setw(17) << kernel << " | "
+              << std::setprecision(2) << two_pass / kernel << "x" << std::endl;
+  }
+}
@@ -0,0 +1,77 @@
+//
+// Latency and CPU cost of the RealtimeRubberBand profiles, 48 kHz stereo pitched by 1.25.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "Benchmark.h"
+#include "../rubberband/RealtimeRubberBand.h"
+
+void runLatencyBenchmark() {
+  const size_t kSampleRate = 48000;
+  const size_t kChannelCount = 2;
+  const size_t kSeconds = 10;
+
+  struct Profile {
+    const char *name;
+    bool high_quality;
+    int profile;
+  };
+  const Profile profiles[] = {
+      {"default", false, RealtimeRubberBand::kProfileDefault},
+      {"high quality", true, RealtimeRubberBand::kProfileDefault},
+      {"low latency", false, RealtimeRubberBand::kProfileLowLatency},
+  };
+
+  std::cout << "profile      | block | stretcher | first output | total (ms) | avg (us) | max (us) | cpu" << std::endl;
+  for (const auto &profile : profiles) {
+    RealtimeRubberBand rubber_band(kSampleRate, kChannelCount, profile.high_quality, false, 0, 0, 512,
+                                   profile.profile);
+    rubber_band.setPitch(1.25);
+    const size_t block_size = rubber_band.getBlockLatency();
+
+    std::vector<float> input(kChannelCount * block_size);
+    std::vector<float> output(kChannelCount * block_size);
+    size_t frame = 0;
+    size_t first_output = 0;
+    double total_us = 0;
+    double max_us = 0;
+    const size_t blocks = kSampleRate * kSeconds / block_size;
+    for (size_t block = 0; block < blocks; ++block) {
+      for (size_t i = 0; i < block_size; ++i) {
+        const auto value = static_cast<float>(0.5 * std::sin(2.0 * M_PI * 440.0 * (frame + i) / kSampleRate));
+        for (size_t channel = 0; channel < kChannelCount; ++channel) {
+          input[channel * block_size + i] = value;
+        }
+      }
+      const double us = measure([&]() {
+        rubber_band.push(reinterpret_cast<uintptr_t>(input.data()), block_size);
+        rubber_band.pull(reinterpret_cast<uintptr_t>(output.data()), block_size);
+      }, 1);
+      frame += block_size;
+      if (first_output == 0 && rubber_band.getUnderrunFrames() < frame) {
+        // Every frame pulled before the first output was an underrun
+        first_output = rubber_band.getUnderrunFrames();
+      }
+      total_us += us;
+      max_us = std::max(max_us, us);
+    }
+
+    const double avg_us = total_us / static_cast<double>(blocks);
+    const double block_us = 1e6 * static_cast<double>(block_size) / kSampleRate;
+    const double total_ms = 1e3 * static_cast<double>(rubber_band.getBlockLatency() +
+        rubber_band.getStretcherLatency()) / kSampleRate;
+    std::cout << std::left << std::setw(12) << profile.name << std::right << " | "
+              << std::setw(5) << block_size << " | "
+              << std::setw(9) << rubber_band.getStretcherLatency() << " | "
+              << std::setw(12) << first_output << " | "
+              << std::setw(10) << std::fixed << std::setprecision(1) << total_ms << " | "
+              << std::setw(8) << avg_us << " | "
+              << std::setw(8) << max_us << " | "
+              << std::setprecision(1) << 100.0 * avg_us / block_us << "%" << std::endl;
+  }
+}
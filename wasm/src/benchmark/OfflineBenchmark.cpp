@@ -0,0 +1,211 @@
+//
+// Heap use and render time of the offline classes, 30 s of 48 kHz stereo stretched by 1.25.
+//
+// The global allocator is replaced for the whole benchmark binary and tracks the bytes allocated through
+// operator new. Input and output belong to the caller and are allocated before measuring. Rubber Band's own
+// aligned buffers bypass operator new and are the same for every class, so they are not part of the numbers.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+#include "Benchmark.h"
+#include "../rubberband/OfflineRubberBand.h"
+#include "../rubberband/RubberBandAPI.h"
+#include "../rubberband/RubberBandFinal.h"
+#include "../rubberband/RubberBandProcessor.h"
+#include "../rubberband/RubberBandSource.h"
+
+namespace {
+
+std::atomic<size_t> heap_bytes{0};
+std::atomic<size_t> heap_peak{0};
+
+// Every allocation carries its size in front, so delete knows what to subtract
+const size_t kHeader = alignof(std::max_align_t);
+
+void *trackedAllocate(std::size_t size) {
+  auto *block = static_cast<char *>(std::malloc(size + kHeader));
+  if (!block) throw std::bad_alloc();
+  *reinterpret_cast<size_t *>(block) = size;
+  const size_t bytes = heap_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = heap_peak.load(std::memory_order_relaxed);
+  while (bytes > peak && !heap_peak.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+  }
+  return block + kHeader;
+}
+
+void trackedFree(void *ptr) {
+  if (!ptr) return;
+  auto *block = static_cast<char *>(ptr) - kHeader;
+  heap_bytes.fetch_sub(*reinterpret_cast<size_t *>(block), std::memory_order_relaxed);
+  std::free(block);
+}
+
+}  // namespace
+
+void *operator new(std::size_t size) { return trackedAllocate(size); }
+void *operator new[](std::size_t size) { return trackedAllocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try { return trackedAllocate(size); } catch (...) { return nullptr; }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  try { return trackedAllocate(size); } catch (...) { return nullptr; }
+}
+void operator delete(void *ptr) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr) noexcept { trackedFree(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { trackedFree(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { trackedFree(ptr); }
+
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kChannelCount = 2;
+const size_t kSeconds = 30;
+const double kTimeRatio = 1.25;
+const size_t kQuantum = 128;
+
+struct Result {
+  double peak_mb;
+  double milliseconds;
+};
+
+// Peak heap growth while fn runs, in MB
+template<typename Function>
+Result track(Function fn) {
+  const size_t base = heap_bytes.load();
+  heap_peak = base;
+  const double milliseconds = measure(fn, 1) / 1e3;
+  return {static_cast<double>(heap_peak.load() - base) / (1024.0 * 1024.0), milliseconds};
+}
+
+}  // namespace
+
+void runOfflineBenchmark() {
+  const size_t input_size = kSampleRate * kSeconds;
+  const auto output_size = static_cast<size_t>(std::ceil(static_cast<double>(input_size) * kTimeRatio)) + kQuantum;
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(input_size));
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  std::vector<const float *> input_channels(kChannelCount);
+  std::vector<float *> output_channels(kChannelCount);
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < input_size; ++i) {
+      input[channel][i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * 220.0 * (1.0 + 0.5 * channel) * i / kSampleRate));
+    }
+    input_channels[channel] = input[channel].data();
+    output_channels[channel] = output[channel].data();
+  }
+  const auto input_ptr = reinterpret_cast<uintptr_t>(input_channels.data());
+  const auto output_ptr = reinterpret_cast<uintptr_t>(output_channels.data());
+  std::vector<const float *> input_slice(kChannelCount);
+  std::vector<float *> output_slice(kChannelCount);
+  const auto input_slice_ptr = reinterpret_cast<uintptr_t>(input_slice.data());
+  const auto output_slice_ptr = reinterpret_cast<uintptr_t>(output_slice.data());
+  const double input_mb = static_cast<double>(input_size * kChannelCount * sizeof(float)) / (1024.0 * 1024.0);
+
+  struct Row {
+    const char *name;
+    Result result;
+  };
+  std::vector<Row> rows;
+
+  rows.push_back({"OfflineRubberBand", track([&]() {
+    OfflineRubberBand rubber_band(kSampleRate, kChannelCount, kTimeRatio, 1.0);
+    rubber_band.setInput(input_channels.data(), input_size);
+    rubber_band.render(output_channels.data(), 0, output_size);
+  })});
+
+  rows.push_back({"RubberBandProcessor", track([&]() {
+    RubberBandProcessor processor(kSampleRate, kChannelCount, kTimeRatio, 1.0);
+    processor.setBuffer(input_ptr, input_size);
+    processor.retrieve(output_ptr, processor.getOutputSize());
+  })});
+
+  rows.push_back({"RubberBandSource", track([&]() {
+    RubberBandSource source(kSampleRate, kChannelCount);
+    source.setBuffer(input_ptr, input_size);
+    source.setTimeRatio(kTimeRatio);
+    for (size_t offset = 0; offset + kQuantum <= output_size; offset += kQuantum) {
+      for (size_t channel = 0; channel < kChannelCount; ++channel) {
+        output_slice[channel] = output[channel].data() + offset;
+      }
+      if (source.retrieve(output_slice_ptr) == 0) break;
+    }
+  })});
+
+  rows.push_back({"RubberBandAPI", track([&]() {
+    RubberBandAPI api(kSampleRate, kChannelCount, kTimeRatio, 1.0);
+    for (int pass = 0; pass < 2; ++pass) {
+      size_t written = 0;
+      for (size_t offset = 0; offset < input_size; offset += kQuantum) {
+        const size_t frames = std::min(kQuantum, input_size - offset);
+        const bool final = offset + frames >= input_size;
+        for (size_t channel = 0; channel < kChannelCount; ++channel) {
+          input_slice[channel] = input[channel].data() + offset;
+        }
+        if (pass == 0) {
+          api.study(input_slice_ptr, frames, final);
+          continue;
+        }
+        api.process(input_slice_ptr, frames, final);
+        size_t available;
+        while ((available = std::min(api.available(), output_size - written)) > 0) {
+          for (size_t channel = 0; channel < kChannelCount; ++channel) {
+            output_slice[channel] = output[channel].data() + written;
+          }
+          const size_t retrieved = api.retrieve(output_slice_ptr, available);
+          if (retrieved == 0) break;
+          written += retrieved;
+        }
+      }
+    }
+  })});
+
+  rows.push_back({"RubberBandFinal", track([&]() {
+    RubberBandFinal rubber_band_final(kSampleRate, kChannelCount, input_size, kTimeRatio, 1.0);
+    for (size_t offset = 0; offset < input_size; offset += kQuantum) {
+      for (size_t channel = 0; channel < kChannelCount; ++channel) {
+        input_slice[channel] = input[channel].data() + offset;
+      }
+      rubber_band_final.push(input_slice_ptr, std::min(kQuantum, input_size - offset));
+    }
+    for (size_t offset = 0; offset + kQuantum <= output_size; offset += kQuantum) {
+      for (size_t channel = 0; channel < kChannelCount; ++channel) {
+        output_slice[channel] = output[channel].data() + offset;
+      }
+      if (rubber_band_final.pull(output_slice_ptr, kQuantum)) break;
+    }
+  })});
+
+  rows.push_back({"Final (streamed)", track([&]() {
+    RubberBandFinal rubber_band_final(kSampleRate, kChannelCount, input_size, kTimeRatio, 1.0);
+    rubber_band_final.setInputCallback([&](float *const *destination, size_t input_frame, size_t frame_count) {
+      const size_t frames = std::min(frame_count, input_size - input_frame);
+      for (size_t channel = 0; channel < kChannelCount; ++channel) {
+        std::copy(input[channel].data() + input_frame, input[channel].data() + input_frame + frames,
+                  destination[channel]);
+      }
+      return frames;
+    });
+    for (size_t offset = 0; offset + kQuantum <= output_size; offset += kQuantum) {
+      for (size_t channel = 0; channel < kChannelCount; ++channel) {
+        output_slice[channel] = output[channel].data() + offset;
+      }
+      if (rubber_band_final.pull(output_slice_ptr, kQuantum)) break;
+    }
+  })});
+
+  std::cout << "input " << std::fixed << std::setprecision(1) << input_mb << " MB" << std::endl;
+  std::cout << "class               | peak heap (MB) | x input | render (ms)" << std::endl;
+  for (const auto &row : rows) {
+    std::cout << std::left << std::setw(19) << row.name << std::right << " | "
+              << std::setw(14) << std::setprecision(2) << row.result.peak_mb << " | "
+              << std::setw(7) << row.result.peak_mb / input_mb << " | "
+              << std::setw(11) << std::setprecision(0) << row.result.milliseconds << std::endl;
+  }
+}
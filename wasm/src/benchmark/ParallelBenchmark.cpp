@@ -0,0 +1,85 @@
+//
+// ParallelOfflineRubberBand with 1 to N threads against OfflineRubberBand, 30 s of 48 kHz stereo stretched by 1.25.
+// Quality is the largest difference of the 2048-frame RMS envelope to the single stretcher's output; the phases
+// of independent stretchers differ, so comparing samples would not mean much.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "Benchmark.h"
+#include "../rubberband/OfflineRubberBand.h"
+#include "../rubberband/ParallelOfflineRubberBand.h"
+
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kChannelCount = 2;
+const size_t kSeconds = 30;
+const double kTimeRatio = 1.25;
+const size_t kWindow = 2048;
+
+double getMaxEnvelopeDifference(const std::vector<std::vector<float>> &a, const std::vector<std::vector<float>> &b) {
+  double result = 0.0;
+  for (size_t channel = 0; channel < a.size(); ++channel) {
+    for (size_t begin = 0; begin + kWindow <= a[channel].size(); begin += kWindow) {
+      double energy_a = 0.0;
+      double energy_b = 0.0;
+      for (size_t i = begin; i < begin + kWindow; ++i) {
+        energy_a += a[channel][i] * a[channel][i];
+        energy_b += b[channel][i] * b[channel][i];
+      }
+      result = std::max(result, std::abs(10.0 * std::log10((energy_a + 1e-9) / (energy_b + 1e-9))));
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+void runParallelBenchmark() {
+  const size_t input_size = kSampleRate * kSeconds;
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(input_size));
+  std::vector<const float *> input_channels(kChannelCount);
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < input_size; ++i) {
+      const double t = static_cast<double>(i) / kSampleRate;
+      input[channel][i] = static_cast<float>((0.3 + 0.2 * std::sin(2.0 * M_PI * 0.7 * t)) *
+          (std::sin(2.0 * M_PI * 196.0 * t) + 0.5 * std::sin(2.0 * M_PI * (440.0 + 55.0 * channel) * t)));
+    }
+    input_channels[channel] = input[channel].data();
+  }
+
+  OfflineRubberBand single(kSampleRate, kChannelCount, kTimeRatio, 1.0);
+  const size_t output_size = std::lround(static_cast<double>(input_size) * kTimeRatio);
+  std::vector<std::vector<float>> reference(kChannelCount, std::vector<float>(output_size));
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  std::vector<float *> reference_channels(kChannelCount);
+  std::vector<float *> output_channels(kChannelCount);
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    reference_channels[channel] = reference[channel].data();
+    output_channels[channel] = output[channel].data();
+  }
+  const double single_ms = measure([&]() {
+    single.setInput(input_channels.data(), input_size);
+    single.render(reference_channels.data(), 0, output_size);
+  }, 1) / 1e3;
+
+  const size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+  std::cout << cores << " cores, single stretcher " << std::fixed << std::setprecision(0) << single_ms << " ms"
+            << std::endl;
+  std::cout << "threads | render (ms) | speedup | envelope diff (dB)" << std::endl;
+  for (size_t threads = 1; threads <= std::max<size_t>(cores, 4); threads *= 2) {
+    ParallelOfflineRubberBand parallel(kSampleRate, kChannelCount, kTimeRatio, 1.0, threads);
+    const double milliseconds = measure([&]() {
+      parallel.render(input_channels.data(), input_size, output_channels.data());
+    }, 1) / 1e3;
+    std::cout << std::setw(7) << threads << " | "
+              << std::setw(11) << std::setprecision(0) << milliseconds << " | "
+              << std::setw(6) << std::setprecision(2) << single_ms / milliseconds << "x | "
+              << std::setw(18) << getMaxEnvelopeDifference(output, reference) << std::endl;
+  }
+}
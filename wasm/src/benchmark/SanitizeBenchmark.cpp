@@ -0,0 +1,64 @@
+//
+// Compares the sanitize kernels with the per-sample std::isfinite loop OfflineRubberBand used before, on clean
+// chunks (scan only, the common case) and on chunks with 1% NaN (scan and copy).
+//
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include "Benchmark.h"
+#include "../rubberband/Sanitize.h"
+
+// What the engine used to do: find a bad sample, then copy with a branch per sample
+static size_t sanitizeIsFinite(const float *source, float *destination, size_t sample_count) {
+  size_t i = 0;
+  while (i < sample_count && std::isfinite(source[i])) {
+    ++i;
+  }
+  if (i == sample_count) {
+    return 0;
+  }
+  size_t count = 0;
+  for (i = 0; i < sample_count; ++i) {
+    const bool finite = std::isfinite(source[i]);
+    count += !finite;
+    destination[i] = finite ? source[i] : 0.0f;
+  }
+  return count;
+}
+
+void runSanitizeBenchmark() {
+  const size_t kChunkSize = 1024;
+  const size_t kIterations = 200000;
+  volatile size_t sink = 0;
+
+  std::cout << "kernel: " << getSanitizeKernelName() << ", chunk size " << kChunkSize << std::endl;
+  std::cout << "input | isfinite (us) | scalar (us) | kernel (us) | speedup vs isfinite" << std::endl;
+  for (const bool dirty : {false, true}) {
+    std::vector<float> source(kChunkSize);
+    for (size_t i = 0; i < kChunkSize; ++i) {
+      source[i] = dirty && i % 100 == 7 ? std::numeric_limits<float>::quiet_NaN()
+                                        : static_cast<float>(std::sin(0.01 * static_cast<double>(i)));
+    }
+    std::vector<float> destination(kChunkSize);
+    const double is_finite = measure([&]() {
+      sink = sink + sanitizeIsFinite(source.data(), destination.data(), kChunkSize);
+    }, kIterations);
+    const double scalar = measure([&]() {
+      sink = sink + (findNonFiniteScalar(source.data(), kChunkSize) < kChunkSize
+                     ? copySanitizedScalar(source.data(), destination.data(), kChunkSize) : 0);
+    }, kIterations);
+    const double kernel = measure([&]() {
+      sink = sink + (findNonFinite(source.data(), kChunkSize) < kChunkSize
+                     ? copySanitized(source.data(), destination.data(), kChunkSize) : 0);
+    }, kIterations);
+
+    std::cout << std::setw(5) << (dirty ? "1%" : "clean") << " | "
+              << std::setw(13) << std::fixed << std::setprecision(3) << is_finite << " | "
+              << std::setw(11) << scalar << " | "
+              << std::setw(11) << kernel << " | "
+              << std::setprecision(2) << is_finite / kernel << "x" << std::endl;
+  }
+}
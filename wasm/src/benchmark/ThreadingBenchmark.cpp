@@ -0,0 +1,89 @@
+//
+// Offline stretching of 2, 6 and 8 channels with and without Rubber Band's processing threads.
+// Rubber Band 3.0 only threads the R2 engine in offline mode (one thread per channel), so R3 is listed for
+// comparison. Without RUBBERBAND_THREADED both R2 columns run on one thread.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <RubberBandStretcher.h>
+#include "Benchmark.h"
+
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kSeconds = 5;
+const size_t kChunkSize = 1024;
+
+// Studies and stretches the whole input by 1.5, returns the duration in milliseconds
+double stretch(const std::vector<std::vector<float>> &input, RubberBand::RubberBandStretcher::Options options) {
+  const size_t channel_count = input.size();
+  const size_t frame_count = input[0].size();
+  std::vector<std::vector<float>> output(channel_count, std::vector<float>(kChunkSize * 4));
+  std::vector<const float *> input_channels(channel_count);
+  std::vector<float *> output_channels(channel_count);
+  for (size_t channel = 0; channel < channel_count; ++channel) {
+    output_channels[channel] = output[channel].data();
+  }
+
+  return measure([&]() {
+    RubberBand::RubberBandStretcher stretcher(kSampleRate, channel_count, options, 1.5, 1.0);
+    stretcher.setExpectedInputDuration(frame_count);
+    for (int pass = 0; pass < 2; ++pass) {
+      for (size_t offset = 0; offset < frame_count; offset += kChunkSize) {
+        const size_t frames = std::min(kChunkSize, frame_count - offset);
+        const bool final = offset + frames >= frame_count;
+        for (size_t channel = 0; channel < channel_count; ++channel) {
+          input_channels[channel] = input[channel].data() + offset;
+        }
+        if (pass == 0) {
+          stretcher.study(input_channels.data(), frames, final);
+          continue;
+        }
+        stretcher.process(input_channels.data(), frames, final);
+        int available;
+        while ((available = stretcher.available()) > 0) {
+          stretcher.retrieve(output_channels.data(), std::min<size_t>(available, kChunkSize * 4));
+        }
+      }
+    }
+  }, 1) / 1e3;
+}
+
+}  // namespace
+
+void runThreadingBenchmark() {
+#ifdef RUBBERBAND_THREADED
+  std::cout << "threaded build" << std::endl;
+#else
+  std::cout << "single-threaded build (configure with -DRUBBERBAND_THREADED=ON)" << std::endl;
+#endif
+  const RubberBand::RubberBandStretcher::Options kR2 = RubberBand::RubberBandStretcher::OptionProcessOffline |
+      RubberBand::RubberBandStretcher::OptionEngineFaster;
+  const RubberBand::RubberBandStretcher::Options kR3 = RubberBand::RubberBandStretcher::OptionProcessOffline |
+      RubberBand::RubberBandStretcher::OptionEngineFiner;
+
+  std::cout << "channels | R2 1 thread (ms) | R2 threads (ms) | speedup | R3 (ms)" << std::endl;
+  for (const size_t channel_count : {2, 6, 8}) {
+    // Detuned sines, so the channels are not identical
+    std::vector<std::vector<float>> input(channel_count, std::vector<float>(kSampleRate * kSeconds));
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      const double frequency = 220.0 * (1.0 + 0.1 * static_cast<double>(channel));
+      for (size_t i = 0; i < input[channel].size(); ++i) {
+        input[channel][i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * frequency * i / kSampleRate));
+      }
+    }
+
+    const double single = stretch(input, kR2 | RubberBand::RubberBandStretcher::OptionThreadingNever);
+    const double threaded = stretch(input, kR2 | RubberBand::RubberBandStretcher::OptionThreadingAlways);
+    const double finer = stretch(input, kR3);
+    std::cout << std::setw(8) << channel_count << " | "
+              << std::setw(16) << std::fixed << std::setprecision(1) << single << " | "
+              << std::setw(15) << threaded << " | "
+              << std::setw(6) << std::setprecision(2) << single / threaded << "x | "
+              << std::setw(7) << std::setprecision(1) << finer << std::endl;
+  }
+}
@@ -0,0 +1,33 @@
+//
+// Benchmark runner, pass suite names to run a subset (e.g. "benchmark interleave").
+//
+
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "Benchmark.h"
+
+int main(int argc, char **argv) {
+  const std::vector<std::pair<const char *, std::function<void()>>> suites = {
+      {"engines", runEngineBenchmark},
+      {"interleave", runInterleaveBenchmark},
+      {"latency", runLatencyBenchmark},
+      {"offline", runOfflineBenchmark},
+      {"parallel", runParallelBenchmark},
+      {"sanitize", runSanitizeBenchmark},
+      {"threading", runThreadingBenchmark},
+  };
+  for (const auto &suite : suites) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; ++i) {
+      selected |= std::strcmp(argv[i], suite.first) == 0;
+    }
+    if (selected) {
+      std::cout << "== " << suite.first << " ==" << std::endl;
+      suite.second();
+    }
+  }
+  return 0;
+}
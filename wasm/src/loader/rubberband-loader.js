@@ -0,0 +1,31 @@
+// Picks the rubberband-simd build where the engine supports wasm simd128, the baseline build everywhere else.
+// AudioWorklets cannot import modules dynamically, so this runs on the main thread and returns the URL to pass to
+// audioWorklet.addModule().
+
+// Smallest module using a simd128 instruction: a function returning i8x16.popcnt(i8x16.splat(0))
+const SIMD_PROBE = new Uint8Array([
+  0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11,
+]);
+
+let simdSupported;
+
+export function isSimdSupported() {
+  if (simdSupported === undefined) {
+    try {
+      simdSupported = typeof WebAssembly === "object" && WebAssembly.validate(SIMD_PROBE);
+    } catch (_) {
+      simdSupported = false;
+    }
+  }
+  return simdSupported;
+}
+
+export function selectBuild(baselineUrl, simdUrl) {
+  return simdUrl && isSimdSupported() ? simdUrl : baselineUrl;
+}
+
+export async function addRubberBandModule(audioContext, baselineUrl, simdUrl) {
+  const url = selectBuild(baselineUrl, simdUrl);
+  await audioContext.audioWorklet.addModule(url);
+  return url;
+}
@@ -120,7 +120,7 @@ int main(int argc, char **argv) {
 
   std::cout << "RubberBandFinal > pull" << std::endl;
   for (size_t f = 0; f < sample_count; f += frame_size) {
-    rubber_band_final->pull(reinterpret_cast<uintptr_t>(some_buffer), frame_size);
+    rubber_band_final->pull(reinterpret_cast<uintptr_t>(output), frame_size);
   }
 
   delete rubber_band_final;
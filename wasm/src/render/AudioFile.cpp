@@ -0,0 +1,189 @@
+//
+// Memory-mapped WAV and raw PCM files for the batch renderer.
+//
+
+#include "AudioFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+uint16_t readUint16(const uint8_t *data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t readUint32(const uint8_t *data) {
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+      (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+void writeUint16(uint8_t *data, uint16_t value) {
+  data[0] = static_cast<uint8_t>(value);
+  data[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void writeUint32(uint8_t *data, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    data[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+size_t getOutputFileSize(const std::string &path,
+                         size_t channel_count,
+                         size_t frame_count,
+                         bool wav,
+                         SampleFormat sample_format) {
+  const size_t data_size = frame_count * channel_count * getBytesPerSample(sample_format);
+  if (!wav) {
+    return data_size;
+  }
+  if (data_size > UINT32_MAX - AudioFileWriter::kWavHeaderSize) {
+    throw std::range_error("Output " + path + " is too long for WAV, write raw instead");
+  }
+  return AudioFileWriter::kWavHeaderSize + data_size;
+}
+
+}  // namespace
+
+bool isWavPath(const std::string &path) {
+  if (path.size() < 4) {
+    return false;
+  }
+  std::string extension = path.substr(path.size() - 4);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return extension == ".wav";
+}
+
+AudioFileReader::AudioFileReader(const std::string &path, const AudioFormat &raw_format)
+    : file_(MappedFile::openForReading(path)),
+      format_(raw_format),
+      samples_(file_.data()) {
+  if (file_.size() >= 12 && std::memcmp(file_.data(), "RIFF", 4) == 0 &&
+      std::memcmp(file_.data() + 8, "WAVE", 4) == 0) {
+    parseWav();
+  } else {
+    if (format_.channel_count == 0) {
+      throw std::runtime_error("Raw input " + path + " needs a channel count");
+    }
+    frame_count_ = file_.size() / (format_.channel_count * getBytesPerSample(format_.sample_format));
+  }
+}
+
+void AudioFileReader::parseWav() {
+  wav_ = true;
+  const uint8_t *data = file_.data();
+  const size_t size = file_.size();
+  bool has_format = false;
+  for (size_t position = 12; position + 8 <= size;) {
+    const uint8_t *chunk = data + position;
+    const size_t chunk_size = readUint32(chunk + 4);
+    const size_t body = position + 8;
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && body + 16 <= size) {
+      uint16_t tag = readUint16(chunk + 8);
+      if (tag == kFormatExtensible && chunk_size >= 26 && body + 26 <= size) {
+        // The sub-format GUID starts with the plain format tag
+        tag = readUint16(chunk + 8 + 24);
+      }
+      format_.channel_count = readUint16(chunk + 10);
+      format_.sample_rate = readUint32(chunk + 12);
+      if (format_.channel_count == 0 || format_.sample_rate == 0) {
+        throw std::runtime_error("WAV fmt chunk without channels or sample rate");
+      }
+      const uint16_t bits = readUint16(chunk + 22);
+      if (tag == kFormatFloat && bits == 32) {
+        format_.sample_format = SampleFormat::kFloat32;
+      } else if (tag == kFormatPcm && bits == 16) {
+        format_.sample_format = SampleFormat::kInt16;
+      } else if (tag == kFormatPcm && bits == 24) {
+        format_.sample_format = SampleFormat::kInt24;
+      } else if (tag == kFormatPcm && bits == 32) {
+        format_.sample_format = SampleFormat::kInt32;
+      } else {
+        throw std::runtime_error("Unsupported WAV format " + std::to_string(tag) + " with " +
+            std::to_string(bits) + " bits");
+      }
+      has_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!has_format) {
+        throw std::runtime_error("WAV data before a valid fmt chunk");
+      }
+      // Streamed WAVs leave the size open, take what is there
+      const size_t data_size = std::min(chunk_size, size - body);
+      samples_ = data + body;
+      frame_count_ = data_size / (format_.channel_count * getBytesPerSample(format_.sample_format));
+      return;
+    }
+    // Chunks are padded to an even size
+    position = body + chunk_size + (chunk_size & 1);
+  }
+  throw std::runtime_error("WAV file without data");
+}
+
+const AudioFormat &AudioFileReader::getFormat() const {
+  return format_;
+}
+
+bool AudioFileReader::isWav() const {
+  return wav_;
+}
+
+size_t AudioFileReader::getFrameCount() const {
+  return frame_count_;
+}
+
+size_t AudioFileReader::read(float *const *destination, size_t frame, size_t frame_count) const {
+  frame_count = std::min(frame_count, frame_count_ - std::min(frame, frame_count_));
+  const uint8_t *source = samples_ + frame * format_.channel_count * getBytesPerSample(format_.sample_format);
+  deinterleavePcm(source, format_.sample_format, destination, 0, format_.channel_count, frame_count);
+  return frame_count;
+}
+
+AudioFileWriter::AudioFileWriter(const std::string &path,
+                                 size_t sample_rate,
+                                 size_t channel_count,
+                                 size_t frame_count,
+                                 bool wav,
+                                 SampleFormat sample_format)
+    : channel_count_(channel_count),
+      frame_count_(frame_count),
+      sample_format_(sample_format),
+      file_(MappedFile::createForWriting(path,
+                                         getOutputFileSize(path, channel_count, frame_count, wav, sample_format))) {
+  const size_t sample_size = getBytesPerSample(sample_format);
+  const size_t data_size = frame_count * channel_count * sample_size;
+  const size_t header_size = wav ? kWavHeaderSize : 0;
+  uint8_t *header = file_.data();
+  if (wav) {
+    const uint16_t block_align = static_cast<uint16_t>(channel_count * sample_size);
+    std::memcpy(header, "RIFF", 4);
+    writeUint32(header + 4, static_cast<uint32_t>(kWavHeaderSize - 8 + data_size));
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    writeUint32(header + 16, 16);
+    writeUint16(header + 20, sample_format == SampleFormat::kFloat32 ? kFormatFloat : kFormatPcm);
+    writeUint16(header + 22, static_cast<uint16_t>(channel_count));
+    writeUint32(header + 24, static_cast<uint32_t>(sample_rate));
+    writeUint32(header + 28, static_cast<uint32_t>(sample_rate * block_align));
+    writeUint16(header + 32, block_align);
+    writeUint16(header + 34, static_cast<uint16_t>(sample_size * 8));
+    std::memcpy(header + 36, "data", 4);
+    writeUint32(header + 40, static_cast<uint32_t>(data_size));
+  }
+  samples_ = header + header_size;
+}
+
+void AudioFileWriter::write(const float *const *source, size_t frame, size_t frame_count) {
+  frame_count = std::min(frame_count, frame_count_ - std::min(frame, frame_count_));
+  interleavePcm(source, 0, samples_ + frame * channel_count_ * getBytesPerSample(sample_format_), sample_format_,
+                channel_count_, frame_count);
+}
+
+size_t AudioFileWriter::getFrameCount() const {
+  return frame_count_;
+}
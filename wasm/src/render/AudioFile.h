@@ -0,0 +1,76 @@
+//
+// Memory-mapped WAV and raw PCM files for the batch renderer.
+//
+
+#ifndef WASM_SRC_RENDER_AUDIOFILE_H_
+#define WASM_SRC_RENDER_AUDIOFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+#include "../rubberband/PcmConversion.h"
+
+struct AudioFormat {
+  size_t sample_rate = 48000;
+  size_t channel_count = 2;
+  SampleFormat sample_format = SampleFormat::kFloat32;
+};
+
+// Reads interleaved PCM straight from the mapped file, converting only the frames asked for
+class AudioFileReader {
+ public:
+  // WAV files (PCM 16/24/32 bit or float) are recognized by their header, anything else is read as raw
+  // interleaved samples in raw_format. Throws std::runtime_error for files that cannot be read.
+  AudioFileReader(const std::string &path, const AudioFormat &raw_format);
+
+  [[nodiscard]] const AudioFormat &getFormat() const;
+
+  [[nodiscard]] bool isWav() const;
+
+  [[nodiscard]] size_t getFrameCount() const;
+
+  // Writes frame_count planar float frames from frame on to destination[channel], returns the frames written.
+  // Matches OfflineRubberBand::InputCallback.
+  size_t read(float *const *destination, size_t frame, size_t frame_count) const;
+
+ private:
+  void parseWav();
+
+  MappedFile file_;
+  AudioFormat format_;
+  bool wav_ = false;
+  const uint8_t *samples_;
+  size_t frame_count_ = 0;
+};
+
+// Writes interleaved PCM into a file mapped at its final size, as WAV or raw samples
+class AudioFileWriter {
+ public:
+  static const size_t kWavHeaderSize = 44;
+
+  AudioFileWriter(const std::string &path,
+                  size_t sample_rate,
+                  size_t channel_count,
+                  size_t frame_count,
+                  bool wav,
+                  SampleFormat sample_format = SampleFormat::kFloat32);
+
+  // Interleaves and converts frame_count frames of source[channel] to the file from frame on, frames past the end
+  // are dropped
+  void write(const float *const *source, size_t frame, size_t frame_count);
+
+  [[nodiscard]] size_t getFrameCount() const;
+
+ private:
+  size_t channel_count_;
+  size_t frame_count_;
+  SampleFormat sample_format_;
+  MappedFile file_;
+  uint8_t *samples_;
+};
+
+// Whether the path ends in .wav, in any case
+[[nodiscard]] bool isWavPath(const std::string &path);
+
+#endif //WASM_SRC_RENDER_AUDIOFILE_H_
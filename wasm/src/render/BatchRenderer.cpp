@@ -0,0 +1,103 @@
+//
+// Offline rendering of a list of files, for pre-rendering outside the browser.
+//
+
+#include "BatchRenderer.h"
+#include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include "../rubberband/OfflineRubberBand.h"
+
+namespace {
+
+// Positive number or the default for a missing field
+double parseRatio(const std::string &field, double default_value) {
+  if (field.empty()) {
+    return default_value;
+  }
+  size_t parsed = 0;
+  double value = 0.0;
+  try {
+    value = std::stod(field, &parsed);
+  } catch (const std::exception &) {
+    parsed = 0;
+  }
+  if (parsed != field.size() || !(value > 0.0)) {
+    throw std::range_error("Not a positive ratio: " + field);
+  }
+  return value;
+}
+
+}  // namespace
+
+std::vector<RenderJob> parseJobs(std::istream &jobs) {
+  std::vector<RenderJob> result;
+  std::string line;
+  for (size_t line_number = 1; std::getline(jobs, line); ++line_number) {
+    std::istringstream fields(line);
+    RenderJob job;
+    std::string time_ratio;
+    std::string pitch_scale;
+    std::string rest;
+    fields >> job.input_path >> job.output_path >> time_ratio >> pitch_scale >> rest;
+    if (job.input_path.empty() || job.input_path[0] == '#') {
+      continue;
+    }
+    if (job.output_path.empty() || !rest.empty()) {
+      throw std::range_error("Job " + std::to_string(line_number) + " does not parse: " + line);
+    }
+    job.time_ratio = parseRatio(time_ratio, 1.0);
+    job.pitch_scale = parseRatio(pitch_scale, 1.0);
+    result.push_back(job);
+  }
+  return result;
+}
+
+double RenderResult::getRealtimeFactor() const {
+  const double audio_seconds = static_cast<double>(input_frames) / static_cast<double>(sample_rate);
+  return seconds > 0.0 ? audio_seconds / seconds : 0.0;
+}
+
+BatchRenderer::BatchRenderer(const AudioFormat &raw_format, SampleFormat output_format)
+    : raw_format_(raw_format),
+      output_format_(output_format) {}
+
+RenderResult BatchRenderer::render(const RenderJob &job) const {
+  RenderScratch scratch;
+  return render(job, scratch);
+}
+
+RenderResult BatchRenderer::render(const RenderJob &job, RenderScratch &scratch) const {
+  const auto start = std::chrono::steady_clock::now();
+  // The output is truncated while the input is still mapped
+  std::error_code error;
+  if (std::filesystem::equivalent(job.input_path, job.output_path, error)) {
+    throw std::runtime_error("Output " + job.output_path + " is the input file");
+  }
+  const AudioFileReader input(job.input_path, raw_format_);
+  const AudioFormat &format = input.getFormat();
+
+  OfflineRubberBand rubber_band(format.sample_rate, format.channel_count, job.time_ratio, job.pitch_scale);
+  rubber_band.setInput([&input](float *const *destination, size_t frame, size_t frame_count) {
+    return input.read(destination, frame, frame_count);
+  }, input.getFrameCount());
+  AudioFileWriter output(job.output_path, format.sample_rate, format.channel_count, rubber_band.getOutputSize(),
+                         isWavPath(job.output_path), output_format_);
+
+  if (scratch.block.size() < format.channel_count) {
+    scratch.block.resize(format.channel_count, std::vector<float>(kBlockSize));
+    scratch.channels.resize(format.channel_count);
+    for (size_t channel = 0; channel < format.channel_count; ++channel) {
+      scratch.channels[channel] = scratch.block[channel].data();
+    }
+  }
+  // The file is zeroed already where the stretcher ends a frame early
+  size_t position = 0;
+  for (size_t rendered; (rendered = rubber_band.render(scratch.channels.data(), 0, kBlockSize)) > 0;) {
+    output.write(scratch.channels.data(), position, rendered);
+    position += rendered;
+  }
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return {format.sample_rate, input.getFrameCount(), output.getFrameCount(), elapsed.count()};
+}
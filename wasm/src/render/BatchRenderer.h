@@ -0,0 +1,61 @@
+//
+// Offline rendering of a list of files, for pre-rendering outside the browser.
+//
+
+#ifndef WASM_SRC_RENDER_BATCHRENDERER_H_
+#define WASM_SRC_RENDER_BATCHRENDERER_H_
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+#include "AudioFile.h"
+
+struct RenderJob {
+  std::string input_path;
+  std::string output_path;
+  double time_ratio = 1.0;
+  double pitch_scale = 1.0;
+};
+
+struct RenderResult {
+  size_t sample_rate;
+  size_t input_frames;
+  size_t output_frames;
+  double seconds;
+
+  // Seconds of input rendered per second of wall time
+  [[nodiscard]] double getRealtimeFactor() const;
+};
+
+// Block buffers a renderer thread keeps from job to job
+struct RenderScratch {
+  std::vector<std::vector<float>> block;
+  std::vector<float *> channels;
+};
+
+// One job per line: input output [time_ratio [pitch_scale]]. Blank lines and lines starting with # are skipped,
+// throws std::range_error for anything else that does not parse.
+std::vector<RenderJob> parseJobs(std::istream &jobs);
+
+// Streams every input from its mapped file through OfflineRubberBand into an output file mapped at its final
+// size, a block at a time. Outputs ending in .wav are WAV, anything else raw interleaved samples. A job writing
+// its own input throws std::runtime_error.
+class BatchRenderer {
+ public:
+  static const size_t kBlockSize = 4096;
+
+  // raw_format describes inputs without a WAV header, output_format the samples written
+  explicit BatchRenderer(const AudioFormat &raw_format = {}, SampleFormat output_format = SampleFormat::kFloat32);
+
+  RenderResult render(const RenderJob &job) const;
+
+  // Same, with block buffers reused across the calls of one thread
+  RenderResult render(const RenderJob &job, RenderScratch &scratch) const;
+
+ private:
+  AudioFormat raw_format_;
+  SampleFormat output_format_;
+};
+
+#endif //WASM_SRC_RENDER_BATCHRENDERER_H_
@@ -0,0 +1,223 @@
+//
+// Batch renderer: job lists, mapped WAV/raw files, a whole render against the in-memory engine and the pool.
+//
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "AudioFile.h"
+#include "BatchRenderer.h"
+#include "RenderPool.h"
+#include "../rubberband/OfflineRubberBand.h"
+
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kChannelCount = 2;
+
+std::string tempPath(const std::string &name) {
+  return ::testing::TempDir() + name;
+}
+
+void writeBytes(const std::string &path, const std::vector<uint8_t> &bytes) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+void append(std::vector<uint8_t> &bytes, uint32_t value, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+}  // namespace
+
+TEST(BatchRenderer, ParsesJobList) {
+  std::istringstream list("# catalog\n"
+                          "\n"
+                          "a.wav a-slow.wav 1.25\n"
+                          "b.raw b-up.raw 1 1.5\n"
+                          "c.wav c.wav\n");
+  const auto jobs = parseJobs(list);
+  ASSERT_EQ(jobs.size(), 3);
+  EXPECT_EQ(jobs[0].output_path, "a-slow.wav");
+  EXPECT_DOUBLE_EQ(jobs[0].time_ratio, 1.25);
+  EXPECT_DOUBLE_EQ(jobs[0].pitch_scale, 1.0);
+  EXPECT_DOUBLE_EQ(jobs[1].pitch_scale, 1.5);
+  EXPECT_DOUBLE_EQ(jobs[2].time_ratio, 1.0);
+
+  for (const char *broken : {"only-input.wav\n", "a.wav b.wav fast\n", "a.wav b.wav 0\n", "a.wav b.wav 1 1 1\n"}) {
+    std::istringstream line(broken);
+    EXPECT_THROW(parseJobs(line), std::range_error) << broken;
+  }
+}
+
+TEST(BatchRenderer, ReadsIntegerWav) {
+  // 24 bit stereo with a LIST chunk before the data
+  std::vector<uint8_t> wav = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '};
+  append(wav, 16, 4);
+  append(wav, 1, 2);
+  append(wav, kChannelCount, 2);
+  append(wav, kSampleRate, 4);
+  append(wav, kSampleRate * kChannelCount * 3, 4);
+  append(wav, kChannelCount * 3, 2);
+  append(wav, 24, 2);
+  wav.insert(wav.end(), {'L', 'I', 'S', 'T', 3, 0, 0, 0, 'a', 'b', 'c', 0});
+  wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+  append(wav, 12, 4);
+  append(wav, 0x400000, 3);  // 0.5
+  append(wav, 0xC00000, 3);  // -0.5
+  append(wav, 0x7FFFFF, 3);
+  append(wav, 0x800000, 3);  // -1
+  const std::string path = tempPath("int24.wav");
+  writeBytes(path, wav);
+
+  const AudioFileReader reader(path, {});
+  ASSERT_TRUE(reader.isWav());
+  EXPECT_EQ(reader.getFormat().sample_format, SampleFormat::kInt24);
+  EXPECT_EQ(reader.getFormat().channel_count, kChannelCount);
+  ASSERT_EQ(reader.getFrameCount(), 2);
+  std::vector<float> left(4, 9.0f);
+  std::vector<float> right(4, 9.0f);
+  float *destination[] = {left.data(), right.data()};
+  EXPECT_EQ(reader.read(destination, 0, 4), 2);
+  EXPECT_FLOAT_EQ(left[0], 0.5f);
+  EXPECT_FLOAT_EQ(right[0], -0.5f);
+  EXPECT_NEAR(left[1], 1.0f, 1e-6);
+  EXPECT_FLOAT_EQ(right[1], -1.0f);
+}
+
+TEST(BatchRenderer, RejectsWavWithoutSampleRate) {
+  std::vector<uint8_t> wav = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '};
+  append(wav, 16, 4);
+  append(wav, 1, 2);
+  append(wav, kChannelCount, 2);
+  append(wav, 0, 4);
+  append(wav, 0, 4);
+  append(wav, kChannelCount * 2, 2);
+  append(wav, 16, 2);
+  wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+  append(wav, 4, 4);
+  append(wav, 0, 4);
+  const std::string path = tempPath("no-rate.wav");
+  writeBytes(path, wav);
+  EXPECT_THROW(AudioFileReader(path, {}), std::runtime_error);
+}
+
+TEST(BatchRenderer, RendersJobLikeTheEngine) {
+  const size_t input_size = kSampleRate;
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(input_size));
+  std::vector<const float *> input_channels;
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < input_size; ++i) {
+      input[channel][i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * 330.0 * (1.0 + channel) * i / kSampleRate));
+    }
+    input_channels.push_back(input[channel].data());
+  }
+  const RenderJob job{tempPath("input.wav"), tempPath("output.wav"), 1.5, 1.2};
+  {
+    AudioFileWriter writer(job.input_path, kSampleRate, kChannelCount, input_size, true);
+    writer.write(input_channels.data(), 0, input_size);
+  }
+
+  const RenderResult result = BatchRenderer().render(job);
+  EXPECT_EQ(result.input_frames, input_size);
+
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, job.time_ratio, job.pitch_scale);
+  rubber_band.setInput(input_channels.data(), input_size);
+  const size_t output_size = rubber_band.getOutputSize();
+  ASSERT_EQ(result.output_frames, output_size);
+  std::vector<std::vector<float>> expected(kChannelCount, std::vector<float>(output_size));
+  std::vector<float *> expected_channels = {expected[0].data(), expected[1].data()};
+  rubber_band.render(expected_channels.data(), 0, output_size);
+
+  const AudioFileReader output(job.output_path, {});
+  EXPECT_EQ(output.getFormat().sample_format, SampleFormat::kFloat32);
+  ASSERT_EQ(output.getFrameCount(), output_size);
+  std::vector<std::vector<float>> actual(kChannelCount, std::vector<float>(output_size));
+  std::vector<float *> actual_channels = {actual[0].data(), actual[1].data()};
+  output.read(actual_channels.data(), 0, output_size);
+  EXPECT_EQ(actual, expected);
+}
+
+TEST(BatchRenderer, RefusesToOverwriteInputs) {
+  const size_t input_size = 4096;
+  std::vector<float> samples(input_size, 0.25f);
+  const float *input_channels[] = {samples.data(), samples.data()};
+  const std::string path = tempPath("source.wav");
+  {
+    AudioFileWriter writer(path, kSampleRate, kChannelCount, input_size, true);
+    writer.write(input_channels, 0, input_size);
+  }
+  const std::string same_file = ::testing::TempDir() + "./source.wav";
+  EXPECT_THROW(BatchRenderer().render({path, same_file, 1.5, 1.0}), std::runtime_error);
+
+  // Pool jobs sharing an output, or writing another job's input, do not run
+  const std::vector<RenderJob> jobs = {
+      {path, tempPath("shared.raw"), 1.0, 1.0},
+      {path, tempPath("shared.raw"), 1.5, 1.0},
+      {path, tempPath("chained.raw"), 1.0, 1.0},
+      {tempPath("chained.raw"), tempPath("chained-out.raw"), 1.0, 1.0},
+  };
+  const BatchRenderer renderer;
+  const PoolReport report = RenderPool(renderer, 2).run(jobs);
+  EXPECT_TRUE(report.jobs[0].error.empty()) << report.jobs[0].error;
+  EXPECT_FALSE(report.jobs[1].error.empty());
+  EXPECT_FALSE(report.jobs[2].error.empty());
+
+  // The source is untouched
+  const AudioFileReader reader(path, {});
+  ASSERT_EQ(reader.getFrameCount(), input_size);
+  std::vector<float> left(input_size), right(input_size);
+  float *destination[] = {left.data(), right.data()};
+  reader.read(destination, 0, input_size);
+  EXPECT_EQ(left, samples);
+}
+
+TEST(BatchRenderer, PoolRendersJobsConcurrently) {
+  const size_t input_size = kSampleRate / 4;
+  std::vector<RenderJob> jobs;
+  for (size_t i = 0; i < 5; ++i) {
+    std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(input_size * (i + 1)));
+    std::vector<const float *> input_channels;
+    for (auto &channel : input) {
+      for (size_t frame = 0; frame < channel.size(); ++frame) {
+        channel[frame] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * (220.0 + 110.0 * i) * frame / kSampleRate));
+      }
+      input_channels.push_back(channel.data());
+    }
+    const std::string name = "pool" + std::to_string(i);
+    AudioFileWriter writer(tempPath(name + ".wav"), kSampleRate, kChannelCount, input[0].size(), true);
+    writer.write(input_channels.data(), 0, input[0].size());
+    jobs.push_back({tempPath(name + ".wav"), tempPath(name + "-out.raw"), 1.0 + 0.1 * i, 1.0});
+  }
+  jobs.push_back({tempPath("missing.wav"), tempPath("missing-out.raw"), 1.0, 1.0});
+
+  const BatchRenderer renderer;
+  const RenderPool pool(renderer, 3);
+  size_t finished = 0;
+  const PoolReport report = pool.run(jobs, [&finished](const JobReport &) { ++finished; });
+  EXPECT_EQ(finished, jobs.size());
+  ASSERT_EQ(report.jobs.size(), jobs.size());
+  EXPECT_FALSE(report.jobs.back().error.empty());
+  EXPECT_NEAR(report.audio_seconds, 0.25 * (1 + 2 + 3 + 4 + 5), 1e-9);
+  EXPECT_GT(report.getRealtimeFactor(), 0.0);
+
+  // Same output as rendering one after the other
+  for (size_t i = 0; i + 1 < jobs.size(); ++i) {
+    EXPECT_EQ(report.jobs[i].job.output_path, jobs[i].output_path);
+    ASSERT_TRUE(report.jobs[i].error.empty()) << report.jobs[i].error;
+    EXPECT_GT(report.jobs[i].result.getRealtimeFactor(), 0.0);
+    RenderJob sequential = jobs[i];
+    sequential.output_path = tempPath("sequential.raw");
+    renderer.render(sequential);
+    std::ifstream pooled_file(jobs[i].output_path, std::ios::binary);
+    std::ifstream sequential_file(sequential.output_path, std::ios::binary);
+    const std::string pooled((std::istreambuf_iterator<char>(pooled_file)), std::istreambuf_iterator<char>());
+    const std::string expected((std::istreambuf_iterator<char>(sequential_file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(pooled.size(), report.jobs[i].result.output_frames * kChannelCount * sizeof(float));
+    EXPECT_TRUE(pooled == expected) << jobs[i].input_path;
+  }
+}
@@ -0,0 +1,118 @@
+//
+// Read-only or newly created file mapped into memory (POSIX).
+//
+
+#include "MappedFile.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::runtime_error fileError(const char *what, const std::string &path) {
+  return std::runtime_error(std::string(what) + " " + path + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+MappedFile MappedFile::openForReading(const std::string &path) {
+  const int file_descriptor = ::open(path.c_str(), O_RDONLY);
+  if (file_descriptor < 0) {
+    throw fileError("Cannot open", path);
+  }
+  struct stat status{};
+  if (::fstat(file_descriptor, &status) != 0) {
+    ::close(file_descriptor);
+    throw fileError("Cannot stat", path);
+  }
+  const auto size = static_cast<size_t>(status.st_size);
+  if (size == 0) {
+    return {file_descriptor, nullptr, 0};
+  }
+  void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+  if (data == MAP_FAILED) {
+    ::close(file_descriptor);
+    throw fileError("Cannot map", path);
+  }
+  // Renders read front to back
+  ::madvise(data, size, MADV_SEQUENTIAL);
+  return {file_descriptor, static_cast<uint8_t *>(data), size};
+}
+
+MappedFile MappedFile::createForWriting(const std::string &path, size_t size) {
+  const int file_descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file_descriptor < 0) {
+    throw fileError("Cannot create", path);
+  }
+  if (::ftruncate(file_descriptor, static_cast<off_t>(size)) != 0) {
+    ::close(file_descriptor);
+    throw fileError("Cannot resize", path);
+  }
+  if (size == 0) {
+    return {file_descriptor, nullptr, 0};
+  }
+  void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+  if (data == MAP_FAILED) {
+    ::close(file_descriptor);
+    throw fileError("Cannot map", path);
+  }
+  return {file_descriptor, static_cast<uint8_t *>(data), size};
+}
+
+MappedFile::MappedFile(int file_descriptor, uint8_t *data, size_t size)
+    : file_descriptor_(file_descriptor),
+      data_(data),
+      size_(size) {}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : file_descriptor_(other.file_descriptor_),
+      data_(other.data_),
+      size_(other.size_) {
+  other.file_descriptor_ = -1;
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    file_descriptor_ = other.file_descriptor_;
+    data_ = other.data_;
+    size_ = other.size_;
+    other.file_descriptor_ = -1;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+const uint8_t *MappedFile::data() const {
+  return data_;
+}
+
+uint8_t *MappedFile::data() {
+  return data_;
+}
+
+size_t MappedFile::size() const {
+  return size_;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    ::munmap(data_, size_);
+    data_ = nullptr;
+  }
+  if (file_descriptor_ >= 0) {
+    ::close(file_descriptor_);
+    file_descriptor_ = -1;
+  }
+}
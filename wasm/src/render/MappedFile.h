@@ -0,0 +1,41 @@
+//
+// Read-only or newly created file mapped into memory (POSIX).
+//
+
+#ifndef WASM_SRC_RENDER_MAPPEDFILE_H_
+#define WASM_SRC_RENDER_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile {
+ public:
+  // Maps an existing file for reading, throws std::runtime_error when it cannot be opened
+  static MappedFile openForReading(const std::string &path);
+
+  // Creates (or truncates) the file with size bytes of zeros and maps it for writing
+  static MappedFile createForWriting(const std::string &path, size_t size);
+
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile();
+
+  [[nodiscard]] const uint8_t *data() const;
+
+  [[nodiscard]] uint8_t *data();
+
+  [[nodiscard]] size_t size() const;
+
+ private:
+  MappedFile(int file_descriptor, uint8_t *data, size_t size);
+  void close();
+
+  int file_descriptor_;
+  uint8_t *data_;
+  size_t size_;
+};
+
+#endif //WASM_SRC_RENDER_MAPPEDFILE_H_
@@ -0,0 +1,158 @@
+//
+// Many independent offline renders across all cores.
+//
+
+#include "RenderPool.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+
+namespace {
+
+struct WorkQueue {
+  std::mutex mutex;
+  std::deque<size_t> jobs;
+};
+
+std::optional<size_t> takeOwn(WorkQueue &queue) {
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty()) {
+    return std::nullopt;
+  }
+  const size_t job = queue.jobs.back();
+  queue.jobs.pop_back();
+  return job;
+}
+
+std::optional<size_t> steal(WorkQueue &queue) {
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.jobs.empty()) {
+    return std::nullopt;
+  }
+  const size_t job = queue.jobs.front();
+  queue.jobs.pop_front();
+  return job;
+}
+
+uintmax_t getInputSize(const RenderJob &job) {
+  std::error_code error;
+  const uintmax_t size = std::filesystem::file_size(job.input_path, error);
+  return error ? 0 : size;
+}
+
+// Same file for paths spelled differently, as far as it can be told before the files exist
+std::string getPathKey(const std::string &path) {
+  std::error_code error;
+  const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+  return error ? std::filesystem::path(path).lexically_normal().string() : canonical.string();
+}
+
+// Per job: why it must not run alongside the others, empty when it can
+std::vector<std::string> findConflicts(const std::vector<RenderJob> &jobs) {
+  std::vector<std::string> conflicts(jobs.size());
+  std::vector<std::string> inputs(jobs.size());
+  std::vector<std::string> outputs(jobs.size());
+  std::transform(jobs.begin(), jobs.end(), inputs.begin(),
+                 [](const RenderJob &job) { return getPathKey(job.input_path); });
+  std::transform(jobs.begin(), jobs.end(), outputs.begin(),
+                 [](const RenderJob &job) { return getPathKey(job.output_path); });
+  for (size_t job = 0; job < jobs.size(); ++job) {
+    for (size_t other = 0; other < jobs.size() && conflicts[job].empty(); ++other) {
+      if (other < job && outputs[other] == outputs[job]) {
+        conflicts[job] = "Output " + jobs[job].output_path + " is written by job " + std::to_string(other + 1);
+      } else if (other != job && inputs[other] == outputs[job]) {
+        conflicts[job] = "Output " + jobs[job].output_path + " is read by job " + std::to_string(other + 1);
+      }
+    }
+  }
+  return conflicts;
+}
+
+}  // namespace
+
+double PoolReport::getRealtimeFactor() const {
+  return seconds > 0.0 ? audio_seconds / seconds : 0.0;
+}
+
+RenderPool::RenderPool(const BatchRenderer &renderer, size_t thread_count)
+    : renderer_(renderer),
+      thread_count_(thread_count) {
+  if (thread_count_ == 0) {
+    thread_count_ = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+}
+
+size_t RenderPool::getThreadCount() const {
+  return thread_count_;
+}
+
+PoolReport RenderPool::run(const std::vector<RenderJob> &jobs, const Callback &on_finished) const {
+  const auto start = std::chrono::steady_clock::now();
+  PoolReport report;
+  report.jobs.resize(jobs.size());
+  const size_t thread_count = std::max<size_t>(std::min(thread_count_, jobs.size()), 1);
+
+  // Largest first, dealt round robin; every thread takes from the back of its queue, so reverse each deal
+  std::vector<uintmax_t> sizes(jobs.size());
+  std::transform(jobs.begin(), jobs.end(), sizes.begin(), getInputSize);
+  std::vector<size_t> order(jobs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+  const std::vector<std::string> conflicts = findConflicts(jobs);
+  std::vector<WorkQueue> queues(thread_count);
+  for (size_t i = 0; i < order.size(); ++i) {
+    queues[i % thread_count].jobs.push_front(order[i]);
+  }
+
+  std::mutex callback_mutex;
+  auto work = [&](size_t thread) {
+    RenderScratch scratch;
+    for (;;) {
+      std::optional<size_t> index = takeOwn(queues[thread]);
+      for (size_t other = 1; !index && other < thread_count; ++other) {
+        index = steal(queues[(thread + other) % thread_count]);
+      }
+      // Nothing is queued after the start, so empty queues stay empty
+      if (!index) {
+        return;
+      }
+      JobReport &job_report = report.jobs[*index];
+      job_report.job = jobs[*index];
+      if (!conflicts[*index].empty()) {
+        job_report.error = conflicts[*index];
+      } else {
+        try {
+          job_report.result = renderer_.render(jobs[*index], scratch);
+        } catch (const std::exception &error) {
+          job_report.error = error.what();
+        }
+      }
+      if (on_finished) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        on_finished(job_report);
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t thread = 1; thread < thread_count; ++thread) {
+    workers.emplace_back(work, thread);
+  }
+  work(0);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (const auto &job_report : report.jobs) {
+    if (job_report.error.empty()) {
+      report.audio_seconds += static_cast<double>(job_report.result.input_frames) /
+          static_cast<double>(job_report.result.sample_rate);
+    }
+  }
+  return report;
+}
@@ -0,0 +1,53 @@
+//
+// Many independent offline renders across all cores.
+//
+
+#ifndef WASM_SRC_RENDER_RENDERPOOL_H_
+#define WASM_SRC_RENDER_RENDERPOOL_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "BatchRenderer.h"
+
+struct JobReport {
+  RenderJob job;
+  RenderResult result{};
+  // Empty when the job rendered
+  std::string error;
+};
+
+struct PoolReport {
+  std::vector<JobReport> jobs;
+  // Wall time of the whole batch and the input seconds it rendered
+  double seconds = 0.0;
+  double audio_seconds = 0.0;
+
+  // Input seconds rendered per second of wall time, over all threads
+  [[nodiscard]] double getRealtimeFactor() const;
+};
+
+// Work-stealing pool: every thread owns a queue of jobs, takes the next one from its back and steals from the
+// front of the others once it is empty. Jobs are dealt out largest input file first, so the long renders start
+// early and the short ones fill the gaps. Every thread keeps one RenderScratch for all of its jobs.
+class RenderPool {
+ public:
+  using Callback = std::function<void(const JobReport &report)>;
+
+  // thread_count 0 uses every core
+  explicit RenderPool(const BatchRenderer &renderer, size_t thread_count = 0);
+
+  [[nodiscard]] size_t getThreadCount() const;
+
+  // Renders all jobs and returns their reports in job order. on_finished is called as jobs end, one call at a
+  // time. A failing job is reported with its error, the others still run. Jobs writing a file an earlier job
+  // writes or any other job reads fail without rendering.
+  PoolReport run(const std::vector<RenderJob> &jobs, const Callback &on_finished = nullptr) const;
+
+ private:
+  const BatchRenderer &renderer_;
+  size_t thread_count_;
+};
+
+#endif //WASM_SRC_RENDER_RENDERPOOL_H_
@@ -0,0 +1,148 @@
+//
+// Native batch renderer: time-stretches and pitch-shifts files without the browser.
+//
+// render [--threads N] [--rate HZ] [--channels N] [--format FORMAT] [--output-format FORMAT] JOBS
+// render [options] INPUT OUTPUT [TIME_RATIO [PITCH_SCALE]]
+//
+// JOBS is a job list file (- for stdin), see parseJobs(). Jobs run on a RenderPool of --threads threads (default
+// every core). --rate, --channels and --format describe raw inputs, WAV inputs bring their own format.
+// --output-format sets the samples written (default float32). FORMAT is int16, int24, int32 or float32.
+//
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "BatchRenderer.h"
+#include "RenderPool.h"
+
+namespace {
+
+int usage() {
+  std::cerr << "usage: render [--threads N] [--rate HZ] [--channels N] [--format FORMAT] [--output-format FORMAT]\n"
+               "              JOBS\n"
+               "       render [options] INPUT OUTPUT [TIME_RATIO [PITCH_SCALE]]\n"
+               "FORMAT: int16|int24|int32|float32" << std::endl;
+  return 2;
+}
+
+// Whole decimal numbers above 0 only, strtoul alone takes "12x", "" and "-1"
+bool parseCount(const char *text, size_t &count) {
+  if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+    return false;
+  }
+  errno = 0;
+  char *end = nullptr;
+  const unsigned long value = std::strtoul(text, &end, 10);
+  if (errno != 0 || *end != '\0' || value == 0) {
+    return false;
+  }
+  count = value;
+  return true;
+}
+
+bool parseFormat(const std::string &name, SampleFormat &sample_format) {
+  const std::pair<const char *, SampleFormat> formats[] = {
+      {"int16", SampleFormat::kInt16},
+      {"int24", SampleFormat::kInt24},
+      {"int32", SampleFormat::kInt32},
+      {"float32", SampleFormat::kFloat32},
+  };
+  for (const auto &format : formats) {
+    if (name == format.first) {
+      sample_format = format.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  AudioFormat raw_format;
+  SampleFormat output_format = SampleFormat::kFloat32;
+  size_t thread_count = 0;
+  std::vector<std::string> arguments;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--threads") == 0 && has_value) {
+      if (!parseCount(argv[++i], thread_count)) {
+        return usage();
+      }
+    } else if (std::strcmp(argv[i], "--rate") == 0 && has_value) {
+      if (!parseCount(argv[++i], raw_format.sample_rate)) {
+        return usage();
+      }
+    } else if (std::strcmp(argv[i], "--channels") == 0 && has_value) {
+      if (!parseCount(argv[++i], raw_format.channel_count)) {
+        return usage();
+      }
+    } else if (std::strcmp(argv[i], "--format") == 0 && has_value) {
+      if (!parseFormat(argv[++i], raw_format.sample_format)) {
+        return usage();
+      }
+    } else if (std::strcmp(argv[i], "--output-format") == 0 && has_value) {
+      if (!parseFormat(argv[++i], output_format)) {
+        return usage();
+      }
+    } else {
+      arguments.emplace_back(argv[i]);
+    }
+  }
+  if (arguments.empty() || arguments.size() > 4 || raw_format.sample_rate == 0 || raw_format.channel_count == 0) {
+    return usage();
+  }
+
+  std::vector<RenderJob> jobs;
+  try {
+    if (arguments.size() == 1) {
+      if (arguments[0] == "-") {
+        jobs = parseJobs(std::cin);
+      } else {
+        std::ifstream file(arguments[0]);
+        if (!file) {
+          std::cerr << "Cannot open job list " << arguments[0] << std::endl;
+          return 1;
+        }
+        jobs = parseJobs(file);
+      }
+    } else {
+      std::string line;
+      for (const auto &argument : arguments) {
+        line += argument + " ";
+      }
+      std::istringstream single(line);
+      jobs = parseJobs(single);
+    }
+  } catch (const std::exception &error) {
+    std::cerr << error.what() << std::endl;
+    return 1;
+  }
+
+  const BatchRenderer renderer(raw_format, output_format);
+  const RenderPool pool(renderer, thread_count);
+  int failures = 0;
+  const PoolReport report = pool.run(jobs, [&failures](const JobReport &job_report) {
+    if (!job_report.error.empty()) {
+      std::cerr << job_report.job.input_path << ": " << job_report.error << std::endl;
+      ++failures;
+      return;
+    }
+    const RenderResult &result = job_report.result;
+    const double audio_seconds = static_cast<double>(result.input_frames) / static_cast<double>(result.sample_rate);
+    std::cout << job_report.job.input_path << " -> " << job_report.job.output_path << ": " << std::fixed
+              << std::setprecision(1) << audio_seconds << " s in " << result.seconds << " s, "
+              << result.getRealtimeFactor() << "x realtime" << std::endl;
+  });
+  std::cout << jobs.size() - failures << " of " << jobs.size() << " jobs on " << pool.getThreadCount()
+            << " threads: " << std::fixed << std::setprecision(1) << report.audio_seconds << " s in "
+            << report.seconds << " s, " << report.getRealtimeFactor() << "x realtime" << std::endl;
+  return failures > 0 ? 1 : 0;
+}
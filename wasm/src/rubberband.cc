@@ -1,5 +1,6 @@
 #include "emscripten/bind.h"
 #include "rubberband/RealtimeRubberBand.h"
+#include "rubberband/RealtimeRubberBandHost.h"
 #include "rubberband/RubberBandProcessor.h"
 #include "rubberband/RubberBandSource.h"
 #include "rubberband/RubberBandAPI.h"
@@ -8,14 +9,39 @@
 
 using namespace emscripten;
 
+EMSCRIPTEN_BINDINGS(ENUM_SampleFormat) {
+    enum_<SampleFormat>("SampleFormat")
+        .value("Int16", SampleFormat::kInt16)
+        .value("Int24", SampleFormat::kInt24)
+        .value("Int32", SampleFormat::kInt32)
+        .value("Float32", SampleFormat::kFloat32);
+}
+
 EMSCRIPTEN_BINDINGS(CLASS_RealtimeRubberBand) {
     class_<RealtimeRubberBand>("RealtimeRubberBand")
 
         .constructor<size_t, size_t, bool, bool, int, int, size_t>()
 
+        .constructor<size_t, size_t, bool, bool, int, int, size_t, int>()
+
         .function("getVersion",
                   &RealtimeRubberBand::getVersion)
 
+        .function("getLatency",
+                  &RealtimeRubberBand::getLatency)
+
+        .function("getInputLatency",
+                  &RealtimeRubberBand::getInputLatency)
+
+        .function("getBlockLatency",
+                  &RealtimeRubberBand::getBlockLatency)
+
+        .function("getStretcherLatency",
+                  &RealtimeRubberBand::getStretcherLatency)
+
+        .function("getOutputLatency",
+                  &RealtimeRubberBand::getOutputLatency)
+
         .function("setPitch",
                   &RealtimeRubberBand::setPitch)
 
@@ -25,6 +51,15 @@ EMSCRIPTEN_BINDINGS(CLASS_RealtimeRubberBand) {
         .function("setFormantScale",
                   &RealtimeRubberBand::setFormantScale)
 
+        .function("getTempo",
+                  &RealtimeRubberBand::getTempo)
+
+        .function("getPitch",
+                  &RealtimeRubberBand::getPitch)
+
+        .function("getFormantScale",
+                  &RealtimeRubberBand::getFormantScale)
+
         .function("push",
                   &RealtimeRubberBand::push,
                   allow_raw_pointers())
@@ -33,14 +68,141 @@ EMSCRIPTEN_BINDINGS(CLASS_RealtimeRubberBand) {
                   &RealtimeRubberBand::pull,
                   allow_raw_pointers())
 
+        .function("pushInterleaved",
+                  &RealtimeRubberBand::pushInterleaved,
+                  allow_raw_pointers())
+
+        .function("pullInterleaved",
+                  &RealtimeRubberBand::pullInterleaved,
+                  allow_raw_pointers())
+
         .function("getSamplesAvailable",
                   &RealtimeRubberBand::getSamplesAvailable)
         
         .function("setSABBuffers",
                   &RealtimeRubberBand::setSABBuffers)
-        
+
+        .function("createSharedBuffers",
+                  &RealtimeRubberBand::createSharedBuffers)
+
+        .function("getInputAudioPtr",
+                  &RealtimeRubberBand::getInputAudioPtr)
+
+        .function("getInputControlPtr",
+                  &RealtimeRubberBand::getInputControlPtr)
+
+        .function("getOutputAudioPtr",
+                  &RealtimeRubberBand::getOutputAudioPtr)
+
+        .function("getOutputControlPtr",
+                  &RealtimeRubberBand::getOutputControlPtr)
+
+        .function("process",
+                  &RealtimeRubberBand::process)
+
+        .function("setCatchUp",
+                  &RealtimeRubberBand::setCatchUp)
+
+        .function("setBackpressure",
+                  &RealtimeRubberBand::setBackpressure)
+
+        .function("getCountersPtr",
+                  &RealtimeRubberBand::getCountersPtr)
+
+        .function("getDroppedFrames",
+                  &RealtimeRubberBand::getDroppedFrames)
+
+        .function("getUnderrunFrames",
+                  &RealtimeRubberBand::getUnderrunFrames)
+
+        .function("getOverflowEvents",
+                  &RealtimeRubberBand::getOverflowEvents)
+
+        .function("getSkippedBlocks",
+                  &RealtimeRubberBand::getSkippedBlocks)
+
+        .function("resetCounters",
+                  &RealtimeRubberBand::resetCounters)
+
+        .function("setSilenceGate",
+                  &RealtimeRubberBand::setSilenceGate)
+
+        .function("setTelemetry",
+                  &RealtimeRubberBand::setTelemetry)
+
+        .function("getTelemetryPtr",
+                  &RealtimeRubberBand::getTelemetryPtr)
+
+        .function("resetTelemetry",
+                  &RealtimeRubberBand::resetTelemetry)
+
+        .function("setGovernor",
+                  &RealtimeRubberBand::setGovernor)
+
+        .function("getEngineSwitches",
+                  &RealtimeRubberBand::getEngineSwitches)
+
+        .function("getGovernorLoad",
+                  &RealtimeRubberBand::getGovernorLoad)
+
+        .function("setMaxTimeRatio",
+                  &RealtimeRubberBand::setMaxTimeRatio)
+
+        .function("setOutputHeadroom",
+                  &RealtimeRubberBand::setOutputHeadroom)
+
+        .function("getOutputCapacity",
+                  &RealtimeRubberBand::getOutputCapacity)
+
+        .function("getMemoryUsage",
+                  &RealtimeRubberBand::getMemoryUsage)
+
+        .function("flush",
+                  &RealtimeRubberBand::flush)
+
+        .function("drain",
+                  &RealtimeRubberBand::drain)
+
+        .function("preroll",
+                  &RealtimeRubberBand::preroll,
+                  allow_raw_pointers())
+
+        .function("getPrerollSize",
+                  &RealtimeRubberBand::getPrerollSize);
+}
+
+EMSCRIPTEN_BINDINGS(CLASS_RealtimeRubberBandHost) {
+    class_<RealtimeRubberBandHost>("RealtimeRubberBandHost")
+
+        .constructor<size_t, size_t, size_t>()
+
+        .function("addTrack",
+                  &RealtimeRubberBandHost::addTrack)
+
+        .function("getTrackCount",
+                  &RealtimeRubberBandHost::getTrackCount)
+
+        .function("getTrack",
+                  &RealtimeRubberBandHost::getTrack,
+                  allow_raw_pointers())
+
+        .function("setTrackGain",
+                  &RealtimeRubberBandHost::setTrackGain)
+
+        .function("setTrackActive",
+                  &RealtimeRubberBandHost::setTrackActive)
+
+        .function("createMixBus",
+                  &RealtimeRubberBandHost::createMixBus)
+
+        .function("getMixAudioPtr",
+                  &RealtimeRubberBandHost::getMixAudioPtr)
+
+        .function("getMixControlPtr",
+                  &RealtimeRubberBandHost::getMixControlPtr)
+
         .function("process",
-                  &RealtimeRubberBand::process);
+                  &RealtimeRubberBandHost::process);
 }
 
 EMSCRIPTEN_BINDINGS(CLASS_RubberBandProcessor) {
@@ -51,12 +213,29 @@ EMSCRIPTEN_BINDINGS(CLASS_RubberBandProcessor) {
         .function("getOutputSize",
                   &RubberBandProcessor::getOutputSize)
 
+        .function("setThreadCount",
+                  &RubberBandProcessor::setThreadCount)
+
+        .function("addKeyFrame",
+                  &RubberBandProcessor::addKeyFrame)
+
+        .function("clearKeyFrames",
+                  &RubberBandProcessor::clearKeyFrames)
+
         .function("setBuffer",
                   &RubberBandProcessor::setBuffer,
                   allow_raw_pointers())
 
+        .function("setInterleavedBuffer",
+                  &RubberBandProcessor::setInterleavedBuffer,
+                  allow_raw_pointers())
+
         .function("retrieve",
                   &RubberBandProcessor::retrieve,
+                  allow_raw_pointers())
+
+        .function("retrieveInterleaved",
+                  &RubberBandProcessor::retrieveInterleaved,
                   allow_raw_pointers());
 }
 
@@ -83,12 +262,29 @@ EMSCRIPTEN_BINDINGS(CLASS_RubberBandSource) {
         .function("reset",
                   &RubberBandSource::reset)
 
+        .function("seek",
+                  &RubberBandSource::seek)
+
+        .function("getPosition",
+                  &RubberBandSource::getPosition)
+
+        .function("getNonFiniteSampleCount",
+                  &RubberBandSource::getNonFiniteSampleCount)
+
         .function("setBuffer",
                   &RubberBandSource::setBuffer,
                   allow_raw_pointers())
 
+        .function("setInterleavedBuffer",
+                  &RubberBandSource::setInterleavedBuffer,
+                  allow_raw_pointers())
+
         .function("retrieve",
                   &RubberBandSource::retrieve,
+                  allow_raw_pointers())
+
+        .function("retrieveInterleaved",
+                  &RubberBandSource::retrieveInterleaved,
                   allow_raw_pointers());
 }
 
@@ -115,6 +311,9 @@ EMSCRIPTEN_BINDINGS(CLASS_RubberBandAPI) {
         .function("getSamplesRequired",
                   &RubberBandAPI::getSamplesRequired)
 
+        .function("getNonFiniteSampleCount",
+                  &RubberBandAPI::getNonFiniteSampleCount)
+
         .function("setMaxProcessSize",
                   &RubberBandAPI::setMaxProcessSize);
 }
@@ -128,9 +327,23 @@ EMSCRIPTEN_BINDINGS(CLASS_RubberBandFinal) {
                   &RubberBandFinal::push,
                   allow_raw_pointers())
 
+        .function("pushInterleaved",
+                  &RubberBandFinal::pushInterleaved,
+                  allow_raw_pointers())
+
+        .function("setInputCallback",
+                  select_overload<void(emscripten::val)>(&RubberBandFinal::setInputCallback))
+
         .function("pull",
                   &RubberBandFinal::pull,
-                  allow_raw_pointers());
+                  allow_raw_pointers())
+
+        .function("pullInterleaved",
+                  &RubberBandFinal::pullInterleaved,
+                  allow_raw_pointers())
+
+        .function("getNonFiniteSampleCount",
+                  &RubberBandFinal::getNonFiniteSampleCount);
 }
 
 EMSCRIPTEN_BINDINGS(CLASS_Test) {
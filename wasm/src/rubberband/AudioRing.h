@@ -0,0 +1,38 @@
+//
+// Interleaved audio ring shared with the JavaScript side.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_AUDIORING_H_
+#define WASM_SRC_RUBBERBAND_AUDIORING_H_
+
+#include <cstddef>
+
+class AudioRing {
+ public:
+  // Control word layout (matches FFmpeg SAB): 0=WRITE_PTR, 1=READ_PTR, 2=STATE, etc.
+  static const int kWritePtr = 0;
+  static const int kReadPtr = 1;
+  static const size_t kControlSize = 4;
+
+  virtual ~AudioRing() = default;
+
+  // Ring size in frames
+  [[nodiscard]] virtual size_t getFrameCount() const = 0;
+
+  // Frames that can be read by the consumer
+  [[nodiscard]] virtual size_t getReadSpace() const = 0;
+
+  // Frames that can be written by the producer (one slot is always kept free)
+  [[nodiscard]] virtual size_t getWriteSpace() const = 0;
+
+  // De-interleaves up to frame_count frames into output and advances the read pointer
+  virtual size_t read(float *const *output, size_t frame_count) = 0;
+
+  // Interleaves up to frame_count frames from input and advances the write pointer
+  virtual size_t write(const float *const *input, size_t frame_count) = 0;
+
+  // Consumer side: drops up to frame_count frames without reading them
+  virtual size_t skip(size_t frame_count) = 0;
+};
+
+#endif //WASM_SRC_RUBBERBAND_AUDIORING_H_
@@ -0,0 +1,48 @@
+//
+// Scoped flush-to-zero / denormals-are-zero for the realtime hot path on native builds.
+// WebAssembly has no control over denormal handling, there the guard does nothing.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_DENORMALGUARD_H_
+#define WASM_SRC_RUBBERBAND_DENORMALGUARD_H_
+
+#include <cstdint>
+#if defined(__SSE__) && !defined(__EMSCRIPTEN__)
+#include <xmmintrin.h>
+#endif
+
+class DenormalGuard {
+ public:
+#if defined(__SSE__) && !defined(__EMSCRIPTEN__)
+  // FTZ (bit 15) and DAZ (bit 6) of the MXCSR register
+  DenormalGuard() : state_(_mm_getcsr()) {
+    _mm_setcsr(state_ | 0x8040);
+  }
+
+  ~DenormalGuard() {
+    _mm_setcsr(state_);
+  }
+#elif defined(__aarch64__) && !defined(__EMSCRIPTEN__)
+  // FZ (bit 24) of the FPCR register
+  DenormalGuard() {
+    asm volatile("mrs %0, fpcr" : "=r"(state_));
+    asm volatile("msr fpcr, %0" : : "r"(state_ | (uint64_t(1) << 24)));
+  }
+
+  ~DenormalGuard() {
+    asm volatile("msr fpcr, %0" : : "r"(state_));
+  }
+#endif
+
+  DenormalGuard(const DenormalGuard &) = delete;
+  DenormalGuard &operator=(const DenormalGuard &) = delete;
+
+ private:
+#if defined(__SSE__) && !defined(__EMSCRIPTEN__)
+  unsigned int state_;
+#elif defined(__aarch64__) && !defined(__EMSCRIPTEN__)
+  uint64_t state_;
+#endif
+};
+
+#endif //WASM_SRC_RUBBERBAND_DENORMALGUARD_H_
@@ -0,0 +1,109 @@
+//
+// Audio ring backed by JavaScript TypedArrays (SharedArrayBuffer outside of the WASM heap).
+//
+
+#include "ExternalAudioRing.h"
+
+#ifdef __EMSCRIPTEN__
+
+#include <algorithm>
+#include <utility>
+#include "Interleave.h"
+
+// Frames moved per JS call, bounds the staging buffer
+const size_t kStagingFrames = 1024;
+
+ExternalAudioRing::ExternalAudioRing(emscripten::val audio,
+                                     emscripten::val control,
+                                     size_t frame_count,
+                                     size_t channel_count) :
+    audio_(std::move(audio)),
+    control_(std::move(control)),
+    atomics_(emscripten::val::global("Atomics")),
+    frame_count_(frame_count),
+    channel_count_(channel_count),
+    staging_(kStagingFrames * channel_count),
+    staging_view_(emscripten::val::null()) {
+}
+
+const emscripten::val &ExternalAudioRing::stagingView() {
+  // Memory growth detaches views of a non-shared heap, so the view is refreshed when that happened
+  if (staging_view_.isNull() || staging_view_["byteLength"].as<size_t>() == 0) {
+    staging_view_ = emscripten::val(emscripten::typed_memory_view(staging_.size(), staging_.data()));
+  }
+  return staging_view_;
+}
+
+int32_t ExternalAudioRing::load(int index) const {
+  return atomics_.call<int>("load", control_, index);
+}
+
+void ExternalAudioRing::store(int index, int32_t value) const {
+  atomics_.call<void>("store", control_, index, value);
+}
+
+size_t ExternalAudioRing::getFrameCount() const {
+  return frame_count_;
+}
+
+size_t ExternalAudioRing::getReadSpace() const {
+  int32_t available = load(kWritePtr) - load(kReadPtr);
+  if (available < 0) available += static_cast<int32_t>(frame_count_);
+  return available;
+}
+
+size_t ExternalAudioRing::getWriteSpace() const {
+  int32_t space = load(kReadPtr) - load(kWritePtr) - 1;
+  if (space < 0) space += static_cast<int32_t>(frame_count_);
+  return space;
+}
+
+void ExternalAudioRing::copyFromRing(size_t position, size_t frame_count) {
+  stagingView().call<void>("set", audio_.call<emscripten::val>("subarray",
+                                                               position * channel_count_,
+                                                               (position + frame_count) * channel_count_));
+}
+
+void ExternalAudioRing::copyToRing(size_t position, size_t frame_count) {
+  audio_.call<void>("set", stagingView().call<emscripten::val>("subarray", 0, frame_count * channel_count_),
+                    position * channel_count_);
+}
+
+size_t ExternalAudioRing::read(float *const *output, size_t frame_count) {
+  const size_t to_read = std::min(frame_count, getReadSpace());
+  size_t position = load(kReadPtr);
+  size_t done = 0;
+  while (done < to_read) {
+    // Never cross the end of the ring or the staging buffer within one copy
+    const size_t chunk = std::min(std::min(to_read - done, frame_count_ - position), kStagingFrames);
+    copyFromRing(position, chunk);
+    deinterleave(staging_.data(), output, done, channel_count_, chunk);
+    position = (position + chunk) % frame_count_;
+    done += chunk;
+  }
+  store(kReadPtr, static_cast<int32_t>(position));
+  return to_read;
+}
+
+size_t ExternalAudioRing::skip(size_t frame_count) {
+  const size_t to_skip = std::min(frame_count, getReadSpace());
+  store(kReadPtr, static_cast<int32_t>((load(kReadPtr) + to_skip) % frame_count_));
+  return to_skip;
+}
+
+size_t ExternalAudioRing::write(const float *const *input, size_t frame_count) {
+  const size_t to_write = std::min(frame_count, getWriteSpace());
+  size_t position = load(kWritePtr);
+  size_t done = 0;
+  while (done < to_write) {
+    const size_t chunk = std::min(std::min(to_write - done, frame_count_ - position), kStagingFrames);
+    interleave(input, done, staging_.data(), channel_count_, chunk);
+    copyToRing(position, chunk);
+    position = (position + chunk) % frame_count_;
+    done += chunk;
+  }
+  store(kWritePtr, static_cast<int32_t>(position));
+  return to_write;
+}
+
+#endif //__EMSCRIPTEN__
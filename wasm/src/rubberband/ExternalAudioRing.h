@@ -0,0 +1,51 @@
+//
+// Audio ring backed by JavaScript TypedArrays (SharedArrayBuffer outside of the WASM heap).
+//
+
+#ifndef WASM_SRC_RUBBERBAND_EXTERNALAUDIORING_H_
+#define WASM_SRC_RUBBERBAND_EXTERNALAUDIORING_H_
+
+#ifdef __EMSCRIPTEN__
+
+#include <vector>
+#include <emscripten/val.h>
+#include "AudioRing.h"
+
+class ExternalAudioRing : public AudioRing {
+ public:
+  ExternalAudioRing(emscripten::val audio, emscripten::val control, size_t frame_count, size_t channel_count);
+
+  [[nodiscard]] size_t getFrameCount() const override;
+
+  [[nodiscard]] size_t getReadSpace() const override;
+
+  [[nodiscard]] size_t getWriteSpace() const override;
+
+  size_t read(float *const *output, size_t frame_count) override;
+
+  size_t skip(size_t frame_count) override;
+
+  size_t write(const float *const *input, size_t frame_count) override;
+
+ private:
+  // Every access goes through Atomics.load/store on the JS side
+  [[nodiscard]] int32_t load(int index) const;
+  void store(int index, int32_t value) const;
+
+  // Bulk copies between the JS ring and the interleaved staging buffer in WASM memory
+  void copyFromRing(size_t position, size_t frame_count);
+  void copyToRing(size_t position, size_t frame_count);
+  const emscripten::val &stagingView();
+
+  emscripten::val audio_;
+  emscripten::val control_;
+  emscripten::val atomics_;
+  size_t frame_count_;
+  size_t channel_count_;
+  std::vector<float> staging_;
+  emscripten::val staging_view_;
+};
+
+#endif //__EMSCRIPTEN__
+
+#endif //WASM_SRC_RUBBERBAND_EXTERNALAUDIORING_H_
@@ -0,0 +1,267 @@
+//
+// Interleave/de-interleave kernels between SAB rings and planar stretcher buffers.
+//
+// Mono is a plain copy, stereo and four or more channels use wasm simd128 or SSE2 (AVX for stereo when
+// the CPU has it), three channels fall back to a strided copy per channel.
+//
+
+#include "Interleave.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define INTERLEAVE_SIMD128 1
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define INTERLEAVE_SSE2 1
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTERLEAVE_AVX 1
+#endif
+#endif
+
+void deinterleaveScalar(const float *source, float *const *destination, size_t offset,
+                        size_t channel_count, size_t frame_count) {
+  for (size_t channel = 0; channel < channel_count; ++channel) {
+    float *out = destination[channel] + offset;
+    const float *in = source + channel;
+    for (size_t i = 0; i < frame_count; ++i) {
+      out[i] = in[i * channel_count];
+    }
+  }
+}
+
+void interleaveScalar(const float *const *source, size_t offset, float *destination,
+                      size_t channel_count, size_t frame_count) {
+  for (size_t channel = 0; channel < channel_count; ++channel) {
+    const float *in = source[channel] + offset;
+    float *out = destination + channel;
+    for (size_t i = 0; i < frame_count; ++i) {
+      out[i * channel_count] = in[i];
+    }
+  }
+}
+
+#if defined(INTERLEAVE_SIMD128)
+
+static size_t deinterleaveStereo(const float *source, float *left, float *right, size_t frame_count) {
+  size_t i = 0;
+  for (; i + 4 <= frame_count; i += 4) {
+    const v128_t a = wasm_v128_load(source + i * 2);
+    const v128_t b = wasm_v128_load(source + i * 2 + 4);
+    wasm_v128_store(left + i, wasm_i32x4_shuffle(a, b, 0, 2, 4, 6));
+    wasm_v128_store(right + i, wasm_i32x4_shuffle(a, b, 1, 3, 5, 7));
+  }
+  return i;
+}
+
+static size_t interleaveStereo(const float *left, const float *right, float *destination, size_t frame_count) {
+  size_t i = 0;
+  for (; i + 4 <= frame_count; i += 4) {
+    const v128_t l = wasm_v128_load(left + i);
+    const v128_t r = wasm_v128_load(right + i);
+    wasm_v128_store(destination + i * 2, wasm_i32x4_shuffle(l, r, 0, 4, 1, 5));
+    wasm_v128_store(destination + i * 2 + 4, wasm_i32x4_shuffle(l, r, 2, 6, 3, 7));
+  }
+  return i;
+}
+
+// 4x4 transpose, four channels of a frame per row
+static inline void transpose(v128_t &r0, v128_t &r1, v128_t &r2, v128_t &r3) {
+  const v128_t t0 = wasm_i32x4_shuffle(r0, r1, 0, 4, 1, 5);
+  const v128_t t1 = wasm_i32x4_shuffle(r2, r3, 0, 4, 1, 5);
+  const v128_t t2 = wasm_i32x4_shuffle(r0, r1, 2, 6, 3, 7);
+  const v128_t t3 = wasm_i32x4_shuffle(r2, r3, 2, 6, 3, 7);
+  r0 = wasm_i64x2_shuffle(t0, t1, 0, 2);
+  r1 = wasm_i64x2_shuffle(t0, t1, 1, 3);
+  r2 = wasm_i64x2_shuffle(t2, t3, 0, 2);
+  r3 = wasm_i64x2_shuffle(t2, t3, 1, 3);
+}
+
+static size_t deinterleaveQuad(const float *source, size_t stride, float *const *destination, size_t offset,
+                               size_t frame_count) {
+  size_t i = 0;
+  for (; i + 4 <= frame_count; i += 4) {
+    v128_t r0 = wasm_v128_load(source + i * stride);
+    v128_t r1 = wasm_v128_load(source + (i + 1) * stride);
+    v128_t r2 = wasm_v128_load(source + (i + 2) * stride);
+    v128_t r3 = wasm_v128_load(source + (i + 3) * stride);
+    transpose(r0, r1, r2, r3);
+    wasm_v128_store(destination[0] + offset + i, r0);
+    wasm_v128_store(destination[1] + offset + i, r1);
+    wasm_v128_store(destination[2] + offset + i, r2);
+    wasm_v128_store(destination[3] + offset + i, r3);
+  }
+  return i;
+}
+
+static size_t interleaveQuad(const float *const *source, size_t offset, float *destination, size_t stride,
+                             size_t frame_count) {
+  size_t i = 0;
+  for (; i + 4 <= frame_count; i += 4) {
+    v128_t r0 = wasm_v128_load(source[0] + offset + i);
+    v128_t r1 = wasm_v128_load(source[1] + offset + i);
+    v128_t r2 = wasm_v128_load(source[2] + offset + i);
+    v128_t r3 = wasm_v128_load(source[3] + offset + i);
+    transpose(r0, r1, r2, r3);
+    wasm_v128_store(destination + i * stride, r0);
+    wasm_v128_store(destination + (i + 1) * stride, r1);
+    wasm_v128_store(destination + (i + 2) * stride, r2);
+    wasm_v128_store(destination + (i + 3) * stride, r3);
+  }
+  return i;
+}
+
+#elif defined(INTERLEAVE_SSE2)
+
+#if defined(INTERLEAVE_AVX)
+__attribute__((target("avx")))
+static size_t deinterleaveStereoAVX(const float *source, float *left, float *right, size_t frame_count) {
+  size_t i = 0;
+  for (; i + 8 <= frame_count; i += 8) {
+    const __m256 a = _mm256_loadu_ps(source + i * 2);
+    const __m256 b = _mm256_loadu_ps(source + i * 2 + 8);
+    // Bring frames 0-1 / 4-5 and 2-3 / 6-7 into the same 128 bit lanes first
+    const __m256 lo = _mm256_permute2f128_ps(a, b, 0x20);
+    const __m256 hi = _mm256_permute2f128_ps(a, b, 0x31);
+    _mm256_storeu_ps(left + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm256_storeu_ps(right + i, _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  return i;
+}
+
+__attribute__((target("avx")))
+static size_t interleaveStereoAVX(const float *left, const float *right, float *destination, size_t frame_count) {
+  size_t i = 0;
+  for (; i + 8 <= frame_count; i += 8) {
+    const __m256 l = _mm256_loadu_ps(left + i);
+    const __m256 r = _mm256_loadu_ps(right + i);
+    const __m256 lo = _mm256_unpacklo_ps(l, r);
+    const __m256 hi = _mm256_unpackhi_ps(l, r);
+    _mm256_storeu_ps(destination + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(destination + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  return i;
+}
+
+static const bool kHasAVX = __builtin_cpu_supports("avx");
+#endif
+
+static size_t deinterleaveStereo(const float *source, float *left, float *right, size_t frame_count) {
+  size_t i = 0;
+#if defined(INTERLEAVE_AVX)
+  if (kHasAVX) i = deinterleaveStereoAVX(source, left, right, frame_count);
+#endif
+  for (; i + 4 <= frame_count; i += 4) {
+    const __m128 a = _mm_loadu_ps(source + i * 2);
+    const __m128 b = _mm_loadu_ps(source + i * 2 + 4);
+    _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  return i;
+}
+
+static size_t interleaveStereo(const float *left, const float *right, float *destination, size_t frame_count) {
+  size_t i = 0;
+#if defined(INTERLEAVE_AVX)
+  if (kHasAVX) i = interleaveStereoAVX(left, right, destination, frame_count);
+#endif
+  for (; i + 4 <= frame_count; i += 4) {
+    const __m128 l = _mm_loadu_ps(left + i);
+    const __m128 r = _mm_loadu_ps(right + i);
+    _mm_storeu_ps(destination + i * 2, _mm_unpacklo_ps(l, r));
+    _mm_storeu_ps(destination + i * 2 + 4, _mm_unpackhi_ps(l, r));
+  }
+  return i;
+}
+
+static size_t deinterleaveQuad(const float *source, size_t stride, float *const *destination, size_t offset,
+                               size_t frame_count) {
+  size_t i = 0;
+  for (; i + 4 <= frame_count; i += 4) {
+    __m128 r0 = _mm_loadu_ps(source + i * stride);
+    __m128 r1 = _mm_loadu_ps(source + (i + 1) * stride);
+    __m128 r2 = _mm_loadu_ps(source + (i + 2) * stride);
+    __m128 r3 = _mm_loadu_ps(source + (i + 3) * stride);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(destination[0] + offset + i, r0);
+    _mm_storeu_ps(destination[1] + offset + i, r1);
+    _mm_storeu_ps(destination[2] + offset + i, r2);
+    _mm_storeu_ps(destination[3] + offset + i, r3);
+  }
+  return i;
+}
+
+static size_t interleaveQuad(const float *const *source, size_t offset, float *destination, size_t stride,
+                             size_t frame_count) {
+  size_t i = 0;
+  for (; i + 4 <= frame_count; i += 4) {
+    __m128 r0 = _mm_loadu_ps(source[0] + offset + i);
+    __m128 r1 = _mm_loadu_ps(source[1] + offset + i);
+    __m128 r2 = _mm_loadu_ps(source[2] + offset + i);
+    __m128 r3 = _mm_loadu_ps(source[3] + offset + i);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(destination + i * stride, r0);
+    _mm_storeu_ps(destination + (i + 1) * stride, r1);
+    _mm_storeu_ps(destination + (i + 2) * stride, r2);
+    _mm_storeu_ps(destination + (i + 3) * stride, r3);
+  }
+  return i;
+}
+
+#endif
+
+void deinterleave(const float *source, float *const *destination, size_t offset,
+                  size_t channel_count, size_t frame_count) {
+  if (channel_count == 1) {
+    std::memcpy(destination[0] + offset, source, frame_count * sizeof(float));
+    return;
+  }
+  size_t done = 0;
+#if defined(INTERLEAVE_SIMD128) || defined(INTERLEAVE_SSE2)
+  if (channel_count == 2) {
+    done = deinterleaveStereo(source, destination[0] + offset, destination[1] + offset, frame_count);
+  } else if (channel_count >= 4) {
+    // Groups of four channels, the last group overlaps the previous one when channel_count % 4 != 0
+    for (size_t channel = 0; channel < channel_count; channel += 4) {
+      const size_t first = std::min(channel, channel_count - 4);
+      done = deinterleaveQuad(source + first, channel_count, destination + first, offset, frame_count);
+    }
+  }
+#endif
+  // Remainder (or every frame for other channel counts)
+  deinterleaveScalar(source + done * channel_count, destination, offset + done, channel_count, frame_count - done);
+}
+
+void interleave(const float *const *source, size_t offset, float *destination,
+                size_t channel_count, size_t frame_count) {
+  if (channel_count == 1) {
+    std::memcpy(destination, source[0] + offset, frame_count * sizeof(float));
+    return;
+  }
+  size_t done = 0;
+#if defined(INTERLEAVE_SIMD128) || defined(INTERLEAVE_SSE2)
+  if (channel_count == 2) {
+    done = interleaveStereo(source[0] + offset, source[1] + offset, destination, frame_count);
+  } else if (channel_count >= 4) {
+    for (size_t channel = 0; channel < channel_count; channel += 4) {
+      const size_t first = std::min(channel, channel_count - 4);
+      done = interleaveQuad(source + first, offset, destination + first, channel_count, frame_count);
+    }
+  }
+#endif
+  interleaveScalar(source, offset + done, destination + done * channel_count, channel_count, frame_count - done);
+}
+
+const char *getInterleaveKernelName() {
+#if defined(INTERLEAVE_SIMD128)
+  return "simd128";
+#elif defined(INTERLEAVE_AVX)
+  return kHasAVX ? "avx" : "sse2";
+#elif defined(INTERLEAVE_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,28 @@
+//
+// Interleave/de-interleave kernels between SAB rings and planar stretcher buffers.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_INTERLEAVE_H_
+#define WASM_SRC_RUBBERBAND_INTERLEAVE_H_
+
+#include <cstddef>
+
+// Copies frame_count interleaved frames from source to destination[channel][offset + i]
+void deinterleave(const float *source, float *const *destination, size_t offset,
+                  size_t channel_count, size_t frame_count);
+
+// Copies frame_count frames from source[channel][offset + i] to the interleaved destination
+void interleave(const float *const *source, size_t offset, float *destination,
+                size_t channel_count, size_t frame_count);
+
+// Plain loops without vectorization, used as reference by tests and benchmarks
+void deinterleaveScalar(const float *source, float *const *destination, size_t offset,
+                        size_t channel_count, size_t frame_count);
+
+void interleaveScalar(const float *const *source, size_t offset, float *destination,
+                      size_t channel_count, size_t frame_count);
+
+// Name of the instruction set the kernels above dispatch to (scalar, sse2, avx, simd128)
+const char *getInterleaveKernelName();
+
+#endif //WASM_SRC_RUBBERBAND_INTERLEAVE_H_
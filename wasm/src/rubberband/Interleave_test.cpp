@@ -0,0 +1,33 @@
+//
+// Interleave kernels against the scalar reference, for every channel count and odd lengths.
+//
+#include <gtest/gtest.h>
+#include <vector>
+#include "Interleave.h"
+
+TEST(Interleave, MatchesScalar) {
+  for (size_t channel_count = 1; channel_count <= 8; ++channel_count) {
+    for (size_t frame_count : {0, 1, 3, 4, 7, 8, 9, 31, 129}) {
+      const size_t offset = 5;
+      std::vector<float> interleaved(frame_count * channel_count);
+      for (size_t i = 0; i < interleaved.size(); ++i) {
+        interleaved[i] = static_cast<float>(i) + 0.5f;
+      }
+      std::vector<std::vector<float>> expected(channel_count, std::vector<float>(offset + frame_count, -1.0f));
+      std::vector<std::vector<float>> actual(channel_count, std::vector<float>(offset + frame_count, -1.0f));
+      std::vector<float *> expected_ptrs, actual_ptrs;
+      for (size_t c = 0; c < channel_count; ++c) {
+        expected_ptrs.push_back(expected[c].data());
+        actual_ptrs.push_back(actual[c].data());
+      }
+
+      deinterleaveScalar(interleaved.data(), expected_ptrs.data(), offset, channel_count, frame_count);
+      deinterleave(interleaved.data(), actual_ptrs.data(), offset, channel_count, frame_count);
+      EXPECT_EQ(actual, expected) << channel_count << " channels, " << frame_count << " frames";
+
+      std::vector<float> round_trip(frame_count * channel_count, -1.0f);
+      interleave(actual_ptrs.data(), offset, round_trip.data(), channel_count, frame_count);
+      EXPECT_EQ(round_trip, interleaved) << channel_count << " channels, " << frame_count << " frames";
+    }
+  }
+}
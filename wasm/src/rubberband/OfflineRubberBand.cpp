@@ -3,74 +3,391 @@
 //
 
 #include "OfflineRubberBand.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include "Sanitize.h"
 
-const RubberBand::RubberBandStretcher::Options kOptions = RubberBand::RubberBandStretcher::OptionProcessOffline |
-    RubberBand::RubberBandStretcher::OptionPitchHighConsistency |
-    RubberBand::RubberBandStretcher::OptionEngineFiner;
+OfflineRubberBand::OfflineRubberBand(size_t sample_rate,
+                                     size_t channel_count,
+                                     double time_ratio,
+                                     double pitch_scale,
+                                     RubberBand::RubberBandStretcher::Options options,
+                                     size_t chunk_size)
+    : sample_rate_(sample_rate),
+      channel_count_(channel_count),
+      options_(options),
+      chunk_size_(std::max<size_t>(chunk_size, 1)),
+      time_ratio_(time_ratio),
+      pitch_scale_(pitch_scale) {
+  stretcher_ = createStretcher();
+  input_channels_ = new const float *[channel_count_];
+  output_channels_ = new float *[channel_count_];
+  createScratch();
+}
 
-const size_t kBlockSize = 1024;
+OfflineRubberBand::~OfflineRubberBand() {
+  delete stretcher_;
+  delete[] input_channels_;
+  delete[] output_channels_;
+  deleteScratch();
+}
 
-OfflineRubberBand::OfflineRubberBand(size_t sample_rate, size_t channel_count) {
-  stretcher_ = new RubberBand::RubberBandStretcher(sample_rate, channel_count, kOptions);
+void OfflineRubberBand::setTimeRatio(double time_ratio) {
+  time_ratio_ = time_ratio;
 }
 
-OfflineRubberBand::~OfflineRubberBand() {
+void OfflineRubberBand::setPitchScale(double pitch_scale) {
+  pitch_scale_ = pitch_scale;
+}
+
+double OfflineRubberBand::getTimeRatio() const {
+  return time_ratio_;
+}
+
+double OfflineRubberBand::getPitchScale() const {
+  return pitch_scale_;
+}
+
+void OfflineRubberBand::setKeyFrameMap(const std::map<size_t, size_t> &key_frames) {
+  size_t previous_output = 0;
+  for (const auto &[input_frame, output_frame] : key_frames) {
+    if (input_frame == 0 || output_frame <= previous_output) {
+      throw std::range_error("Key frames have to start after frame 0 and increase in output");
+    }
+    previous_output = output_frame;
+  }
+  key_frames_ = key_frames;
+}
+
+size_t OfflineRubberBand::getOutputFrame(size_t input_frame) const {
+  return std::lround(toOutput(static_cast<double>(input_frame)));
+}
+
+size_t OfflineRubberBand::getInputFrame(size_t output_frame) const {
+  return std::lround(toInput(static_cast<double>(output_frame)));
+}
+
+void OfflineRubberBand::setChunkSize(size_t chunk_size) {
+  chunk_size_ = std::max<size_t>(chunk_size, 1);
+  stretcher_->setMaxProcessSize(chunk_size_);
+  deleteScratch();
+  createScratch();
+}
+
+void OfflineRubberBand::setInput(const float *const *input, size_t input_size) {
+  input_ = input;
+  input_callback_ = nullptr;
+  input_size_ = input_size;
+  restart();
+}
+
+void OfflineRubberBand::setInput(InputCallback input_callback, size_t input_size) {
+  input_ = nullptr;
+  input_callback_ = std::move(input_callback);
+  input_size_ = input_size;
+  restart();
+}
+
+void OfflineRubberBand::setInput(const void *input, SampleFormat sample_format, size_t input_size) {
+  const auto *samples = static_cast<const uint8_t *>(input);
+  const size_t frame_size = channel_count_ * getBytesPerSample(sample_format);
+  setInput([this, samples, sample_format, frame_size, input_size](float *const *destination,
+                                                                  size_t input_frame,
+                                                                  size_t frame_count) {
+    frame_count = std::min(frame_count, input_size - std::min(input_frame, input_size));
+    deinterleavePcm(samples + input_frame * frame_size, sample_format, destination, 0, channel_count_, frame_count);
+    return frame_count;
+  }, input_size);
+}
+
+void OfflineRubberBand::restart(size_t input_position) {
+  // R3's reset() keeps hop sizes and transient state from the last run, a new stretcher renders bit-exact
   delete stretcher_;
+  stretcher_ = createStretcher();
+  non_finite_samples_ = 0;
+  input_position = std::min(input_position, input_size_);
+  const size_t preroll = sample_rate_ * kPrerollMillis / 1000;
+  input_position_ = input_position - std::min(input_position, preroll);
+  output_position_ = getOutputFrame(input_position);
+  // Offline stretchers compensate their latency, output frame n belongs to input frame n / time ratio
+  preroll_frames_ = output_position_ - getOutputFrame(input_position_);
+  if (!hasInput()) {
+    return;
+  }
+  if (!key_frames_.empty() && input_position_ < input_size_) {
+    // The stretcher derives the output length from its overall ratio
+    stretcher_->setTimeRatio(static_cast<double>(getOutputSize() - getOutputFrame(input_position_)) /
+        static_cast<double>(input_size_ - input_position_));
+  }
+  stretcher_->setExpectedInputDuration(input_size_ - input_position_);
+  studyInput(input_position_);
+  applyKeyFrameMap();
+}
+
+void OfflineRubberBand::seek(size_t output_frame) {
+  output_frame = std::min(output_frame, getOutputSize());
+  // Start at the input frame just before, its output frame can only be the same or earlier
+  restart(static_cast<size_t>(std::floor(toInput(static_cast<double>(output_frame)))));
+  if (output_frame > output_position_) {
+    preroll_frames_ += output_frame - output_position_;
+    output_position_ = output_frame;
+  }
+}
+
+size_t OfflineRubberBand::getInputSize() const {
+  return input_size_;
+}
+
+size_t OfflineRubberBand::getOutputSize() const {
+  return getOutputFrame(input_size_);
+}
+
+size_t OfflineRubberBand::getOutputPosition() const {
+  return output_position_;
+}
+
+size_t OfflineRubberBand::getInputPosition() const {
+  return input_position_;
+}
+
+size_t OfflineRubberBand::getNonFiniteSampleCount() const {
+  return non_finite_samples_;
+}
+
+size_t OfflineRubberBand::getSamplesAvailable() const {
+  // available() is -1 once everything has been retrieved
+  return std::max(stretcher_->available(), 0);
+}
+
+bool OfflineRubberBand::isFinished() const {
+  return hasInput() && input_position_ >= input_size_ &&
+      (stretcher_->available() < 0 || output_position_ >= getOutputSize());
 }
 
-void OfflineRubberBand::study(uintptr_t input_ptr, size_t input_size) {
-  auto input = reinterpret_cast<const float *const *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
-  auto sub_array_ptr = new const float *;
-  const auto channel_count = stretcher_->getChannelCount();
-  for (size_t channel = 0; channel < channel_count; ++channel) {
-    for (size_t i = 0; i < input_size; i += kBlockSize) {
-      auto len = std::min(input_size - i, kBlockSize);
-      auto finish = i + kBlockSize > input_size;
-      slice(input, sub_array_ptr, channel_count, i);
-      stretcher_->study(sub_array_ptr, len, finish);
+size_t OfflineRubberBand::prepare(size_t frame_count) {
+  dropPreroll();
+  while (getSamplesAvailable() < frame_count && hasInput() && input_position_ < input_size_) {
+    processChunk();
+  }
+  return getSamplesAvailable();
+}
+
+size_t OfflineRubberBand::render(float *const *output, size_t offset, size_t frame_count) {
+  // A stretcher started within the input may round to one frame more than the whole input stretches to
+  frame_count = std::min(frame_count, getOutputSize() - std::min(output_position_, getOutputSize()));
+  size_t written = 0;
+  while (written < frame_count) {
+    // A chunk at a time, so the stretcher never holds more than a chunk of output
+    const size_t available = prepare(std::min(frame_count - written, chunk_size_));
+    if (available == 0) {
+      break;
+    }
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      output_channels_[channel] = output[channel] + offset + written;
+    }
+    written += stretcher_->retrieve(output_channels_, std::min(available, frame_count - written));
+  }
+  output_position_ += written;
+  return written;
+}
+
+size_t OfflineRubberBand::renderInterleaved(void *output, SampleFormat sample_format, size_t frame_count) {
+  frame_count = std::min(frame_count, getOutputSize() - std::min(output_position_, getOutputSize()));
+  auto *destination = static_cast<uint8_t *>(output);
+  const size_t frame_size = channel_count_ * getBytesPerSample(sample_format);
+  size_t written = 0;
+  while (written < frame_count) {
+    const size_t available = prepare(std::min(frame_count - written, chunk_size_));
+    if (available == 0) {
+      break;
+    }
+    // The stretcher has copied the chunk's input by now, so scratch_ is free to retrieve into
+    const size_t frames = stretcher_->retrieve(scratch_, std::min({available, frame_count - written, chunk_size_}));
+    interleavePcm(scratch_, 0, destination + written * frame_size, sample_format, channel_count_, frames);
+    written += frames;
+  }
+  output_position_ += written;
+  return written;
+}
+
+void OfflineRubberBand::study(const float *const *input, size_t input_size, bool final) {
+  size_t position = 0;
+  do {
+    const size_t frames = std::min(chunk_size_, input_size - position);
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      input_channels_[channel] = input[channel] + position;
+    }
+    position += frames;
+    size_t replaced = 0;  // counted when processed
+    stretcher_->study(sanitize(input_channels_, frames, replaced), frames, final && position >= input_size);
+  } while (position < input_size);
+}
+
+void OfflineRubberBand::process(const float *const *input, size_t input_size, bool final) {
+  size_t position = 0;
+  do {
+    const size_t frames = std::min(chunk_size_, input_size - position);
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      input_channels_[channel] = input[channel] + position;
+    }
+    position += frames;
+    stretcher_->process(sanitize(input_channels_, frames, non_finite_samples_), frames,
+                        final && position >= input_size);
+  } while (position < input_size);
+}
+
+size_t OfflineRubberBand::retrieve(float *const *output, size_t output_size) {
+  return stretcher_->retrieve(output, std::min(output_size, getSamplesAvailable()));
+}
+
+size_t OfflineRubberBand::getSamplesRequired() const {
+  return stretcher_->getSamplesRequired();
+}
+
+RubberBand::RubberBandStretcher *OfflineRubberBand::createStretcher() const {
+  auto stretcher = new RubberBand::RubberBandStretcher(sample_rate_, channel_count_, options_, time_ratio_, pitch_scale_);
+  stretcher->setMaxProcessSize(chunk_size_);
+  return stretcher;
+}
+
+bool OfflineRubberBand::hasInput() const {
+  return input_ != nullptr || input_callback_ != nullptr;
+}
+
+const float *const *OfflineRubberBand::readInput(size_t input_frame, size_t frame_count) {
+  if (input_ != nullptr) {
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      input_channels_[channel] = input_[channel] + input_frame;
     }
+    return input_channels_;
   }
-  delete sub_array_ptr;
+  const size_t frames = std::min(input_callback_(read_buffer_, input_frame, frame_count), frame_count);
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    std::fill(read_buffer_[channel] + frames, read_buffer_[channel] + frame_count, 0.0f);
+  }
+  return read_buffer_;
 }
 
-void OfflineRubberBand::process(uintptr_t input_ptr, size_t sample_size, bool final) {
-  processSlice(input_ptr, 0, sample_size, final);
+void OfflineRubberBand::studyInput(size_t begin) {
+  if ((options_ & RubberBand::RubberBandStretcher::OptionEngineFiner) && key_frames_.empty()) {
+    // R3 takes the length from setExpectedInputDuration(), it only needs the study for the end of a key frame map
+    return;
+  }
+  for (size_t position = begin; position < input_size_;) {
+    const size_t frames = std::min(chunk_size_, input_size_ - position);
+    const float *const *input = readInput(position, frames);
+    position += frames;
+    size_t replaced = 0;  // counted when processed
+    stretcher_->study(sanitize(input, frames, replaced), frames, position >= input_size_);
+  }
 }
 
-void OfflineRubberBand::processSlice(uintptr_t input_ptr, size_t position, size_t sample_size, bool final) {
-  auto *input = reinterpret_cast<const float **>(input_ptr); // NOLINT(performance-no-int-to-ptr)
-  auto input_slice = new const float *;
-  slice(input, input_slice, stretcher_->getChannelCount(), position);
-  if(position != 0) {
-    stretcher_->process(input_slice, sample_size, final);
-  } else {
-    input_slice = &input[0];
+void OfflineRubberBand::applyKeyFrameMap() {
+  if (key_frames_.empty()) {
+    return;
   }
-  delete input_slice;
+  const size_t output_begin = getOutputFrame(input_position_);
+  std::map<size_t, size_t> key_frames;
+  for (auto it = key_frames_.upper_bound(input_position_); it != key_frames_.end() && it->first < input_size_; ++it) {
+    key_frames[it->first - input_position_] = getOutputFrame(it->first) - output_begin;
+  }
+  stretcher_->setKeyFrameMap(key_frames);
 }
 
-void OfflineRubberBand::retrieve(uintptr_t output_ptr, size_t sample_size) {
-  auto output = reinterpret_cast<float **>(output_ptr); // NOLINT(performance-no-int-to-ptr)
-  const auto channel_count = stretcher_->getChannelCount();
-  for (size_t channel = 0; channel < channel_count; ++channel) {
-    stretcher_->retrieve(output, sample_size);
+double OfflineRubberBand::toOutput(double input_frame) const {
+  if (key_frames_.empty()) {
+    return input_frame * time_ratio_;
+  }
+  // Anchors around the frame, (0, 0) before the first one and the last ratio after the last one
+  auto next = key_frames_.upper_bound(static_cast<size_t>(input_frame));
+  if (next == key_frames_.end()) {
+    --next;
+  }
+  const double input_end = static_cast<double>(next->first);
+  const double output_end = static_cast<double>(next->second);
+  double input_begin = 0.0;
+  double output_begin = 0.0;
+  if (next != key_frames_.begin()) {
+    input_begin = static_cast<double>(std::prev(next)->first);
+    output_begin = static_cast<double>(std::prev(next)->second);
   }
+  return output_begin + (input_frame - input_begin) * (output_end - output_begin) / (input_end - input_begin);
 }
 
-void OfflineRubberBand::slice(const float *const *input, const float **output, size_t num_channels, size_t start) {
-  for (size_t channel = 0; channel < num_channels; ++channel) {
-    output[channel] = input[channel] + start;
+double OfflineRubberBand::toInput(double output_frame) const {
+  if (key_frames_.empty()) {
+    return output_frame / time_ratio_;
   }
+  auto next = std::find_if(key_frames_.begin(), key_frames_.end(), [output_frame](const auto &key_frame) {
+    return static_cast<double>(key_frame.second) > output_frame;
+  });
+  if (next == key_frames_.end()) {
+    --next;
+  }
+  const double input_end = static_cast<double>(next->first);
+  const double output_end = static_cast<double>(next->second);
+  double input_begin = 0.0;
+  double output_begin = 0.0;
+  if (next != key_frames_.begin()) {
+    input_begin = static_cast<double>(std::prev(next)->first);
+    output_begin = static_cast<double>(std::prev(next)->second);
+  }
+  return input_begin + (output_frame - output_begin) * (input_end - input_begin) / (output_end - output_begin);
 }
 
-void OfflineRubberBand::setTempo(double tempo) {
-  stretcher_->setTimeRatio(tempo);
+void OfflineRubberBand::dropPreroll() {
+  while (preroll_frames_ > 0) {
+    while (getSamplesAvailable() == 0 && input_position_ < input_size_) {
+      processChunk();
+    }
+    const size_t frames = std::min({getSamplesAvailable(), preroll_frames_, chunk_size_});
+    if (frames == 0) {
+      preroll_frames_ = 0;
+      break;
+    }
+    preroll_frames_ -= stretcher_->retrieve(scratch_, frames);
+  }
 }
 
-void OfflineRubberBand::setPitch(double pitch) {
-  stretcher_->setPitchScale(pitch);
+void OfflineRubberBand::processChunk() {
+  const size_t frames = std::min(chunk_size_, input_size_ - input_position_);
+  const float *const *input = readInput(input_position_, frames);
+  input_position_ += frames;
+  stretcher_->process(sanitize(input, frames, non_finite_samples_), frames, input_position_ >= input_size_);
 }
 
-int OfflineRubberBand::getSamplesAvailable() {
-  return stretcher_->available();
+const float *const *OfflineRubberBand::sanitize(const float *const *input, size_t frame_count, size_t &replaced) {
+  bool finite = true;
+  for (size_t channel = 0; channel < channel_count_ && finite; ++channel) {
+    finite = findNonFinite(input[channel], frame_count) == frame_count;
+  }
+  if (finite) {
+    return input;
+  }
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    replaced += copySanitized(input[channel], scratch_[channel], frame_count);
+  }
+  return scratch_;
+}
+
+void OfflineRubberBand::createScratch() {
+  scratch_ = new float *[channel_count_];
+  read_buffer_ = new float *[channel_count_];
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    scratch_[channel] = new float[chunk_size_];
+    read_buffer_[channel] = new float[chunk_size_];
+  }
+}
+
+void OfflineRubberBand::deleteScratch() {
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    delete[] scratch_[channel];
+    delete[] read_buffer_[channel];
+  }
+  delete[] scratch_;
+  delete[] read_buffer_;
 }
@@ -5,31 +5,153 @@
 #ifndef WASM_SRC_OFFLINERUBBERBAND_H_
 #define WASM_SRC_OFFLINERUBBERBAND_H_
 
+#include <functional>
+#include <map>
 #include <RubberBandStretcher.h>
+#include "PcmConversion.h"
 
+// Offline engine behind RubberBandProcessor, RubberBandSource, RubberBandAPI and RubberBandFinal.
+// Studies and processes in chunks straight from the caller's planar input and retrieves straight into the
+// caller's output, so apart from the stretcher only chunk-sized memory is allocated.
 class OfflineRubberBand {
  public:
-  explicit OfflineRubberBand(size_t sample_rate, size_t channel_count);
+  static constexpr RubberBand::RubberBandStretcher::Options kDefaultOptions =
+      RubberBand::RubberBandStretcher::OptionProcessOffline |
+          RubberBand::RubberBandStretcher::OptionPitchHighConsistency |
+          RubberBand::RubberBandStretcher::OptionEngineFiner;
+  static constexpr size_t kChunkSize = 1024;
+  // Input rendered and dropped before the position restart() starts at, lets the stretcher settle
+  static const size_t kPrerollMillis = 200;
+
+  // Writes frame_count frames from input_frame on to destination[channel], returns the frames written
+  using InputCallback = std::function<size_t(float *const *destination, size_t input_frame, size_t frame_count)>;
+
+  OfflineRubberBand(size_t sample_rate,
+                    size_t channel_count,
+                    double time_ratio = 1.0,
+                    double pitch_scale = 1.0,
+                    RubberBand::RubberBandStretcher::Options options = kDefaultOptions,
+                    size_t chunk_size = kChunkSize);
   ~OfflineRubberBand();
 
-  void setTempo(double tempo);
+  // Ratios take effect with the next setInput() or restart()
+  void setTimeRatio(double time_ratio);
+
+  void setPitchScale(double pitch_scale);
+
+  [[nodiscard]] double getTimeRatio() const;
+
+  [[nodiscard]] double getPitchScale() const;
+
+  // Input frame -> output frame anchors for a variable tempo, rendered in one pass with one study. The tempo is
+  // constant between anchors and keeps the last anchor's ratio up to the end of the input. Output frames have to
+  // increase with the input frames. Takes effect like the ratios, an empty map renders at the time ratio again.
+  void setKeyFrameMap(const std::map<size_t, size_t> &key_frames);
+
+  // Position mapping of the time ratio or key frame map, does not need an input
+  [[nodiscard]] size_t getOutputFrame(size_t input_frame) const;
+
+  [[nodiscard]] size_t getInputFrame(size_t output_frame) const;
+
+  // Largest block handed to the stretcher at once
+  void setChunkSize(size_t chunk_size);
+
+  // Uses the planar input and studies it, the channel pointers have to stay valid until rendering is done
+  void setInput(const float *const *input, size_t input_size);
+
+  // Streams an input of input_size frames through the callback a chunk at a time: one pass to study (R3 skips it
+  // unless there are key frames), one to render. Memory stays at a chunk whatever the length; frames the callback
+  // does not deliver are silent.
+  void setInput(InputCallback input_callback, size_t input_size);
+
+  // Streams interleaved input, converted a chunk at a time as it is read. The buffer has to stay valid like above.
+  void setInput(const void *input, SampleFormat sample_format, size_t input_size);
 
-  void setPitch(double pitch);
+  // Starts rendering again at input_position with a fresh stretcher, which studies the input from there again. R3
+  // gets the length from setExpectedInputDuration() and only studies for a key frame map.
+  void restart(size_t input_position = 0);
 
-  void study(uintptr_t input_ptr, size_t sample_size);
+  // Restarts so that output_frame is rendered next, the work does not depend on the distance
+  void seek(size_t output_frame);
 
-  void process(uintptr_t input_ptr, size_t sample_size, bool final);
+  [[nodiscard]] size_t getInputSize() const;
 
-  void processSlice(uintptr_t input_ptr, size_t position, size_t sample_size, bool final);
+  // Frames the whole input stretches to
+  [[nodiscard]] size_t getOutputSize() const;
 
-  void retrieve(uintptr_t output_ptr, size_t sample_size);
+  // Output frame rendered next, counted from the start of the input
+  [[nodiscard]] size_t getOutputPosition() const;
 
-  int getSamplesAvailable();
+  // Input frames handed to the stretcher so far, counted from the start of the input
+  [[nodiscard]] size_t getInputPosition() const;
+
+  // NaN and Inf input samples processed as silence since the last setInput() or restart()
+  [[nodiscard]] size_t getNonFiniteSampleCount() const;
+
+  [[nodiscard]] size_t getSamplesAvailable() const;
+
+  // True once the whole input has been rendered
+  [[nodiscard]] bool isFinished() const;
+
+  // Processes input until frame_count frames are ready or the input is used up, returns the frames ready
+  size_t prepare(size_t frame_count);
+
+  // Renders up to frame_count frames to output[channel] + offset, returns the frames written (0 at the end)
+  size_t render(float *const *output, size_t offset, size_t frame_count);
+
+  // Same, interleaved in sample_format from output on
+  size_t renderInterleaved(void *output, SampleFormat sample_format, size_t frame_count);
+
+  // Chunked study/process/retrieve for callers that feed the input themselves
+  void study(const float *const *input, size_t input_size, bool final);
+
+  void process(const float *const *input, size_t input_size, bool final);
+
+  size_t retrieve(float *const *output, size_t output_size);
+
+  [[nodiscard]] size_t getSamplesRequired() const;
 
  private:
-  static void slice(const float *const *input, const float **output, size_t num_channels, size_t start);
+  RubberBand::RubberBandStretcher *createStretcher() const;
+  [[nodiscard]] bool hasInput() const;
+  // Views frame_count input frames from input_frame on, read through the callback for streamed input
+  const float *const *readInput(size_t input_frame, size_t frame_count);
+  void studyInput(size_t begin);
+  // Hands the key frames after the stretcher's first input frame over, relative to where it starts
+  void applyKeyFrameMap();
+  [[nodiscard]] double toOutput(double input_frame) const;
+  [[nodiscard]] double toInput(double output_frame) const;
+  void dropPreroll();
+  void processChunk();
+  // Returns input, or scratch_ with NaN and Inf replaced by 0 when there are any. Adds the samples replaced.
+  const float *const *sanitize(const float *const *input, size_t frame_count, size_t &replaced);
+  void createScratch();
+  void deleteScratch();
 
   RubberBand::RubberBandStretcher *stretcher_;
+  size_t sample_rate_;
+  size_t channel_count_;
+  RubberBand::RubberBandStretcher::Options options_;
+  size_t chunk_size_;
+  double time_ratio_;
+  double pitch_scale_;
+  std::map<size_t, size_t> key_frames_;
+
+  const float *const *input_ = nullptr;
+  InputCallback input_callback_;
+  size_t input_size_ = 0;
+  size_t input_position_ = 0;
+  size_t output_position_ = 0;
+  // Output frames of the pre-roll still to drop
+  size_t preroll_frames_ = 0;
+  size_t non_finite_samples_ = 0;
+
+  // Offset views into the caller's buffers
+  const float **input_channels_;
+  float **output_channels_;
+  // Chunk copy for input with NaN or Inf samples, and the chunk streamed input is read to
+  float **scratch_ = nullptr;
+  float **read_buffer_ = nullptr;
 };
 
 #endif //WASM_SRC_OFFLINERUBBERBAND_H_
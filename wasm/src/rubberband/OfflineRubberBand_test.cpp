@@ -0,0 +1,524 @@
+//
+// OfflineRubberBand and the offline classes built on it, rendering straight into caller-owned buffers.
+//
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "OfflineRubberBand.h"
+#include "ParallelOfflineRubberBand.h"
+#include "RubberBandAPI.h"
+#include "RubberBandFinal.h"
+#include "RubberBandProcessor.h"
+#include "RubberBandSource.h"
+
+namespace {
+
+const size_t kSampleRate = 48000;
+const size_t kChannelCount = 2;
+const size_t kInputSize = kSampleRate * 2;
+
+std::vector<std::vector<float>> createInput() {
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(kInputSize));
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < kInputSize; ++i) {
+      input[channel][i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * 330.0 * (1.0 + channel) * i / kSampleRate));
+    }
+  }
+  return input;
+}
+
+template<typename T>
+std::vector<T *> pointers(std::vector<std::vector<float>> &buffers, size_t offset = 0) {
+  std::vector<T *> result;
+  for (auto &buffer : buffers) {
+    result.push_back(buffer.data() + offset);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(OfflineRubberBand, RendersWholeInputIntoCallerBuffer) {
+  auto input = createInput();
+  auto input_channels = pointers<const float>(input);
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, 1.5, 1.2);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  const size_t output_size = rubber_band.getOutputSize();
+  EXPECT_EQ(output_size, kInputSize * 3 / 2);
+
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size + 1024));
+  auto output_channels = pointers<float>(output);
+  const size_t rendered = rubber_band.render(output_channels.data(), 0, output_size + 1024);
+  EXPECT_EQ(rendered, output_size);
+  EXPECT_TRUE(rubber_band.isFinished());
+  EXPECT_EQ(rubber_band.render(output_channels.data(), 0, 128), 0);
+}
+
+TEST(OfflineRubberBand, ChunkedRenderMatchesSingleRender) {
+  auto input = createInput();
+  auto input_channels = pointers<const float>(input);
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, 0.8, 1.0);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  const size_t output_size = rubber_band.getOutputSize();
+  std::vector<std::vector<float>> whole(kChannelCount, std::vector<float>(output_size));
+  auto whole_channels = pointers<float>(whole);
+  ASSERT_EQ(rubber_band.render(whole_channels.data(), 0, output_size), output_size);
+
+  // Same input again, rendered 128 frames at a time at increasing offsets
+  rubber_band.restart();
+  std::vector<std::vector<float>> chunked(kChannelCount, std::vector<float>(output_size));
+  auto chunked_channels = pointers<float>(chunked);
+  size_t position = 0;
+  while (position < output_size) {
+    const size_t rendered = rubber_band.render(chunked_channels.data(), position,
+                                               std::min<size_t>(128, output_size - position));
+    ASSERT_GT(rendered, 0);
+    position += rendered;
+  }
+  EXPECT_EQ(rubber_band.getOutputPosition(), output_size);
+  EXPECT_EQ(chunked, whole);
+}
+
+TEST(OfflineRubberBand, ReplacesNonFiniteInput) {
+  auto input = createInput();
+  input[0][1000] = std::numeric_limits<float>::quiet_NaN();
+  input[1][20000] = std::numeric_limits<float>::infinity();
+  auto input_channels = pointers<const float>(input);
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, 1.0, 1.3);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(rubber_band.getOutputSize()));
+  auto output_channels = pointers<float>(output);
+  rubber_band.render(output_channels.data(), 0, rubber_band.getOutputSize());
+  for (const auto &channel : output) {
+    for (float sample : channel) {
+      ASSERT_TRUE(std::isfinite(sample));
+    }
+  }
+  // The caller's input is left alone, the replaced samples are counted
+  EXPECT_TRUE(std::isnan(input[0][1000]));
+  EXPECT_EQ(rubber_band.getNonFiniteSampleCount(), 2);
+  rubber_band.restart(kInputSize / 2);
+  EXPECT_EQ(rubber_band.getNonFiniteSampleCount(), 0);
+}
+
+TEST(OfflineRubberBand, AdaptersRenderTheSameOutput) {
+  auto input = createInput();
+  auto input_channels = pointers<const float>(input);
+  const auto input_ptr = reinterpret_cast<uintptr_t>(input_channels.data());
+
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, 1.25, 1.0);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  const size_t output_size = rubber_band.getOutputSize();
+  std::vector<std::vector<float>> expected(kChannelCount, std::vector<float>(output_size));
+  auto expected_channels = pointers<float>(expected);
+  rubber_band.render(expected_channels.data(), 0, output_size);
+
+  // RubberBandProcessor: one retrieve() of the whole output
+  RubberBandProcessor processor(kSampleRate, kChannelCount, 1.25, 1.0);
+  ASSERT_EQ(processor.setBuffer(input_ptr, kInputSize), output_size);
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  auto output_channels = pointers<float>(output);
+  EXPECT_EQ(processor.retrieve(reinterpret_cast<uintptr_t>(output_channels.data()), output_size), output_size);
+  EXPECT_EQ(output, expected);
+
+  // RubberBandSource: render quanta
+  RubberBandSource source(kSampleRate, kChannelCount);
+  source.setBuffer(input_ptr, kInputSize);
+  source.setTimeRatio(1.25);
+  ASSERT_EQ(source.getOutputSize(), output_size);
+  for (size_t position = 0; position < output_size;) {
+    std::vector<float *> quantum = pointers<float>(output, position);
+    const size_t received = source.retrieve(reinterpret_cast<uintptr_t>(quantum.data()));
+    ASSERT_GT(received, 0);
+    position += received;
+    ASSERT_LE(position, output_size);
+  }
+  EXPECT_EQ(output, expected);
+}
+
+TEST(OfflineRubberBand, FinalRendersPushedInput) {
+  auto input = createInput();
+  RubberBandFinal rubber_band_final(kSampleRate, kChannelCount, kInputSize, 1.25, 1.0);
+  for (size_t position = 0; position < kInputSize; position += 128) {
+    auto chunk = pointers<const float>(input, position);
+    rubber_band_final.push(reinterpret_cast<uintptr_t>(chunk.data()), std::min<size_t>(128, kInputSize - position));
+  }
+  const size_t output_size = kInputSize * 5 / 4;
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size + 128));
+  size_t position = 0;
+  bool finished = false;
+  while (!finished && position < output_size) {
+    auto quantum = pointers<float>(output, position);
+    finished = rubber_band_final.pull(reinterpret_cast<uintptr_t>(quantum.data()), 128);
+    position += 128;
+  }
+  EXPECT_TRUE(finished);
+  float peak = 0.0f;
+  for (size_t i = output_size / 4; i < output_size / 2; ++i) {
+    peak = std::max(peak, std::abs(output[0][i]));
+  }
+  EXPECT_GT(peak, 0.1f);
+}
+
+TEST(OfflineRubberBand, APIStreamsStudyProcessRetrieve) {
+  auto input = createInput();
+  RubberBandAPI api(kSampleRate, kChannelCount, 1.5, 1.0);
+  for (size_t position = 0; position < kInputSize; position += 512) {
+    auto chunk = pointers<const float>(input, position);
+    const size_t frames = std::min<size_t>(512, kInputSize - position);
+    api.study(reinterpret_cast<uintptr_t>(chunk.data()), frames, position + frames >= kInputSize);
+  }
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(kInputSize * 2));
+  size_t written = 0;
+  for (size_t position = 0; position < kInputSize; position += 512) {
+    auto chunk = pointers<const float>(input, position);
+    const size_t frames = std::min<size_t>(512, kInputSize - position);
+    api.process(reinterpret_cast<uintptr_t>(chunk.data()), frames, position + frames >= kInputSize);
+    size_t available;
+    while ((available = api.available()) > 0) {
+      auto destination = pointers<float>(output, written);
+      written += api.retrieve(reinterpret_cast<uintptr_t>(destination.data()), available);
+    }
+  }
+  EXPECT_EQ(written, kInputSize * 3 / 2);
+}
+
+namespace {
+
+// RMS of every 2048-frame window in dB, independent stretchers agree on it but not on the phases
+std::vector<double> envelope(const std::vector<float> &signal) {
+  std::vector<double> result;
+  for (size_t begin = 0; begin + 2048 <= signal.size(); begin += 2048) {
+    double sum = 0.0;
+    for (size_t i = begin; i < begin + 2048; ++i) {
+      sum += signal[i] * signal[i];
+    }
+    result.push_back(10.0 * std::log10(sum / 2048.0 + 1e-12));
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(OfflineRubberBand, ParallelMatchesSingleThreaded) {
+  // Two tones with a slow tremolo, so a misaligned segment shows up in the envelope
+  const size_t input_size = kSampleRate * 8;
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(input_size));
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < input_size; ++i) {
+      const double t = static_cast<double>(i) / kSampleRate;
+      input[channel][i] = static_cast<float>((0.3 + 0.2 * std::sin(2.0 * M_PI * 1.5 * t)) *
+          (std::sin(2.0 * M_PI * 220.0 * t) + 0.5 * std::sin(2.0 * M_PI * (550.0 + 110.0 * channel) * t)));
+    }
+  }
+  auto input_channels = pointers<const float>(input);
+
+  OfflineRubberBand single(kSampleRate, kChannelCount, 1.3, 0.9);
+  single.setInput(input_channels.data(), input_size);
+  const size_t output_size = single.getOutputSize();
+  std::vector<std::vector<float>> expected(kChannelCount, std::vector<float>(output_size));
+  auto expected_channels = pointers<float>(expected);
+  ASSERT_EQ(single.render(expected_channels.data(), 0, output_size), output_size);
+
+  ParallelOfflineRubberBand parallel(kSampleRate, kChannelCount, 1.3, 0.9, 3);
+  parallel.setSegmentSize(kSampleRate * 2);
+  ASSERT_EQ(parallel.getOutputSize(input_size), output_size);
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  auto output_channels = pointers<float>(output);
+  ASSERT_EQ(parallel.render(input_channels.data(), input_size, output_channels.data()), output_size);
+
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    const auto expected_envelope = envelope(expected[channel]);
+    const auto actual_envelope = envelope(output[channel]);
+    for (size_t window = 0; window < expected_envelope.size(); ++window) {
+      EXPECT_NEAR(actual_envelope[window], expected_envelope[window], 1.0) << "channel " << channel << " window " << window;
+    }
+    // No clicks where the segments meet: no step larger than the biggest one in the single-threaded output
+    float max_step = 0.0f;
+    float expected_max_step = 0.0f;
+    for (size_t i = 1; i < output_size; ++i) {
+      max_step = std::max(max_step, std::abs(output[channel][i] - output[channel][i - 1]));
+      expected_max_step = std::max(expected_max_step, std::abs(expected[channel][i] - expected[channel][i - 1]));
+    }
+    EXPECT_LE(max_step, expected_max_step * 1.1f);
+  }
+}
+
+TEST(OfflineRubberBand, ProcessorRendersInParallel) {
+  auto input = createInput();
+  auto input_channels = pointers<const float>(input);
+  RubberBandProcessor processor(kSampleRate, kChannelCount, 0.75, 1.0);
+  processor.setThreadCount(2);
+  const size_t output_size = processor.setBuffer(reinterpret_cast<uintptr_t>(input_channels.data()), kInputSize);
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  auto output_channels = pointers<float>(output);
+  EXPECT_EQ(processor.retrieve(reinterpret_cast<uintptr_t>(output_channels.data()), output_size), output_size);
+  EXPECT_EQ(processor.retrieve(reinterpret_cast<uintptr_t>(output_channels.data()), output_size), 0);
+}
+
+TEST(OfflineRubberBand, ResolvesThreadCount) {
+  EXPECT_GE(ParallelOfflineRubberBand::resolveThreadCount(0), 1);
+  EXPECT_EQ(ParallelOfflineRubberBand::resolveThreadCount(1), 1);
+  EXPECT_EQ(ParallelOfflineRubberBand::resolveThreadCount(4), 4);
+  ParallelOfflineRubberBand parallel(kSampleRate, kChannelCount, 1.0, 1.0, 0);
+  EXPECT_EQ(parallel.getThreadCount(), ParallelOfflineRubberBand::resolveThreadCount(0));
+}
+
+TEST(OfflineRubberBand, RestartsAtInputPosition) {
+  auto input = createInput();
+  auto input_channels = pointers<const float>(input);
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, 1.5, 1.0);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  const size_t output_size = rubber_band.getOutputSize();
+  std::vector<std::vector<float>> expected(kChannelCount, std::vector<float>(output_size));
+  auto expected_channels = pointers<float>(expected);
+  ASSERT_EQ(rubber_band.render(expected_channels.data(), 0, output_size), output_size);
+
+  const size_t input_position = kInputSize / 2 + 123;
+  rubber_band.restart(input_position);
+  const auto output_position = static_cast<size_t>(std::lround(input_position * 1.5));
+  EXPECT_EQ(rubber_band.getOutputPosition(), output_position);
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size, 0.0f));
+  auto output_channels = pointers<float>(output);
+  EXPECT_EQ(rubber_band.render(output_channels.data(), output_position, output_size), output_size - output_position);
+  EXPECT_TRUE(rubber_band.isFinished());
+
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    std::vector<float> expected_tail(expected[channel].begin() + output_position, expected[channel].end());
+    std::vector<float> tail(output[channel].begin() + output_position, output[channel].end());
+    const auto expected_envelope = envelope(expected_tail);
+    const auto actual_envelope = envelope(tail);
+    // The last window holds the end of the input, which both stretchers pad differently
+    for (size_t window = 0; window + 1 < expected_envelope.size(); ++window) {
+      EXPECT_NEAR(actual_envelope[window], expected_envelope[window], 1.0) << "channel " << channel << " window " << window;
+    }
+  }
+}
+
+TEST(OfflineRubberBand, SourceParameterChangeKeepsPlayPosition) {
+  // 220 Hz for the first second, 880 Hz for the second
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(kInputSize));
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < kInputSize; ++i) {
+      const double frequency = i < kSampleRate ? 220.0 : 880.0;
+      input[channel][i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * frequency * i / kSampleRate));
+    }
+  }
+  auto input_channels = pointers<const float>(input);
+  RubberBandSource source(kSampleRate, kChannelCount);
+  source.setBuffer(reinterpret_cast<uintptr_t>(input_channels.data()), kInputSize);
+
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(128));
+  auto output_channels = pointers<float>(output);
+  const auto output_ptr = reinterpret_cast<uintptr_t>(output_channels.data());
+  for (size_t played = 0; played < kSampleRate * 5 / 4;) {
+    played += source.retrieve(output_ptr);
+  }
+  source.setTimeRatio(1.5);
+  source.setPitchScale(1.0);
+
+  // Zero crossings of the next 4096 frames: 880 Hz gives ~150, a restart from the beginning ~37
+  size_t crossings = 0;
+  float previous = 0.0f;
+  for (size_t frames = 0; frames < 4096;) {
+    const size_t received = source.retrieve(output_ptr);
+    ASSERT_GT(received, 0);
+    for (size_t i = 0; i < received; ++i) {
+      crossings += (output[0][i] >= 0.0f) != (previous >= 0.0f);
+      previous = output[0][i];
+    }
+    frames += received;
+  }
+  EXPECT_GT(crossings, 120);
+}
+
+TEST(OfflineRubberBand, SourceSeeksWithBoundedWork) {
+  // 220 Hz for the first second, 880 Hz for the second
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(kInputSize));
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < kInputSize; ++i) {
+      const double frequency = i < kSampleRate ? 220.0 : 880.0;
+      input[channel][i] = static_cast<float>(0.5 * std::sin(2.0 * M_PI * frequency * i / kSampleRate));
+    }
+  }
+  auto input_channels = pointers<const float>(input);
+  RubberBandSource source(kSampleRate, kChannelCount);
+  source.setBuffer(reinterpret_cast<uintptr_t>(input_channels.data()), kInputSize);
+  source.setTimeRatio(1.5);
+
+  const size_t target = kSampleRate * 2 + 3;
+  EXPECT_EQ(source.seek(target), target);
+  EXPECT_EQ(source.getPosition(), target);
+
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(128));
+  auto output_channels = pointers<float>(output);
+  const auto output_ptr = reinterpret_cast<uintptr_t>(output_channels.data());
+  size_t crossings = 0;
+  float previous = 0.0f;
+  for (size_t frames = 0; frames < 4096;) {
+    const size_t received = source.retrieve(output_ptr);
+    ASSERT_GT(received, 0);
+    for (size_t i = 0; i < received; ++i) {
+      crossings += (output[0][i] >= 0.0f) != (previous >= 0.0f);
+      previous = output[0][i];
+    }
+    frames += received;
+  }
+  EXPECT_EQ(source.getPosition(), target + 4096);
+  EXPECT_GT(crossings, 120);
+
+  // Only the pre-roll before the target was processed, not the input up to it
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount, 1.5);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  rubber_band.seek(target);
+  std::vector<std::vector<float>> block(kChannelCount, std::vector<float>(512));
+  auto block_channels = pointers<float>(block);
+  ASSERT_EQ(rubber_band.render(block_channels.data(), 0, 512), 512);
+  const size_t target_input = target * 2 / 3;
+  const size_t preroll = kSampleRate * OfflineRubberBand::kPrerollMillis / 1000;
+  EXPECT_LE(rubber_band.getInputPosition(), target_input + kSampleRate / 4);
+  EXPECT_GE(rubber_band.getInputPosition(), target_input - preroll);
+}
+
+TEST(OfflineRubberBand, RendersKeyFrameMapInOnePass) {
+  // Quiet tone with 20 ms bursts at input frames 24000 and 72000
+  std::vector<std::vector<float>> input(kChannelCount, std::vector<float>(kInputSize));
+  for (size_t channel = 0; channel < kChannelCount; ++channel) {
+    for (size_t i = 0; i < kInputSize; ++i) {
+      const bool burst = (i >= 24000 && i < 24960) || (i >= 72000 && i < 72960);
+      input[channel][i] = static_cast<float>((burst ? 0.8 : 0.05) * std::sin(2.0 * M_PI * 330.0 * i / kSampleRate));
+    }
+  }
+  auto input_channels = pointers<const float>(input);
+
+  // Unchanged tempo for the first second, half the tempo for the second
+  RubberBandProcessor processor(kSampleRate, kChannelCount);
+  processor.setThreadCount(0);
+  processor.addKeyFrame(kSampleRate, kSampleRate);
+  processor.addKeyFrame(kSampleRate * 2, kSampleRate * 3);
+  EXPECT_THROW(processor.addKeyFrame(kSampleRate * 3, kSampleRate * 2), std::range_error);
+  const size_t output_size = processor.setBuffer(reinterpret_cast<uintptr_t>(input_channels.data()), kInputSize);
+  ASSERT_EQ(output_size, kSampleRate * 3);
+
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  auto output_channels = pointers<float>(output);
+  EXPECT_EQ(processor.retrieve(reinterpret_cast<uintptr_t>(output_channels.data()), output_size), output_size);
+
+  // The bursts land where the map puts them: 24000 -> 24000, 72000 -> 48000 + 24000 * 2
+  const auto levels = envelope(output[0]);
+  const auto loudest = [&levels](size_t begin, size_t end) {
+    return (std::max_element(levels.begin() + begin / 2048, levels.begin() + end / 2048) - levels.begin()) * 2048;
+  };
+  EXPECT_NEAR(static_cast<double>(loudest(0, kSampleRate)), 24000.0, 4096.0);
+  EXPECT_NEAR(static_cast<double>(loudest(kSampleRate, output_size)), 96000.0, 4096.0);
+
+  // Seeking goes through the map as well
+  OfflineRubberBand rubber_band(kSampleRate, kChannelCount);
+  rubber_band.setKeyFrameMap({{kSampleRate, kSampleRate}, {kSampleRate * 2, kSampleRate * 3}});
+  EXPECT_EQ(rubber_band.getOutputFrame(72000), 96000);
+  EXPECT_EQ(rubber_band.getInputFrame(96000), 72000);
+  rubber_band.setInput(input_channels.data(), kInputSize);
+  rubber_band.seek(96000);
+  EXPECT_EQ(rubber_band.getOutputPosition(), 96000);
+  EXPECT_EQ(rubber_band.render(output_channels.data(), 0, output_size), output_size - 96000);
+}
+
+TEST(OfflineRubberBand, StreamsInputThroughCallback) {
+  auto input = createInput();
+  auto input_channels = pointers<const float>(input);
+  size_t frames_read = 0;
+  const auto read = [&](float *const *destination, size_t input_frame, size_t frame_count) {
+    const size_t frames = std::min(frame_count, kInputSize - input_frame);
+    for (size_t channel = 0; channel < kChannelCount; ++channel) {
+      std::copy(input[channel].begin() + input_frame, input[channel].begin() + input_frame + frames,
+                destination[channel]);
+    }
+    frames_read += frames;
+    return frames;
+  };
+
+  // R3 studies without reading, R2 reads everything twice; both render the same as from memory
+  for (const auto engine : {RubberBand::RubberBandStretcher::OptionEngineFiner,
+                            RubberBand::RubberBandStretcher::OptionEngineFaster}) {
+    const auto options = RubberBand::RubberBandStretcher::OptionProcessOffline | engine;
+    OfflineRubberBand in_memory(kSampleRate, kChannelCount, 1.25, 1.0, options);
+    OfflineRubberBand streamed(kSampleRate, kChannelCount, 1.25, 1.0, options);
+    in_memory.setInput(input_channels.data(), kInputSize);
+    frames_read = 0;
+    streamed.setInput(read, kInputSize);
+    EXPECT_EQ(frames_read, engine == RubberBand::RubberBandStretcher::OptionEngineFiner ? 0 : kInputSize);
+
+    const size_t output_size = in_memory.getOutputSize();
+    std::vector<std::vector<float>> expected(kChannelCount, std::vector<float>(output_size));
+    std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+    auto expected_channels = pointers<float>(expected);
+    ASSERT_EQ(in_memory.render(expected_channels.data(), 0, output_size), output_size);
+    for (size_t position = 0; position < output_size; position += 4096) {
+      auto block = pointers<float>(output, position);
+      streamed.render(block.data(), 0, std::min<size_t>(4096, output_size - position));
+    }
+    EXPECT_TRUE(streamed.isFinished());
+    EXPECT_EQ(output, expected);
+  }
+
+  // RubberBandFinal keeps no copy of streamed input
+  RubberBandFinal rubber_band_final(kSampleRate, kChannelCount, kInputSize, 1.25, 1.0);
+  frames_read = 0;
+  rubber_band_final.setInputCallback(read);
+  std::vector<std::vector<float>> quantum(kChannelCount, std::vector<float>(128));
+  auto quantum_channels = pointers<float>(quantum);
+  while (!rubber_band_final.pull(reinterpret_cast<uintptr_t>(quantum_channels.data()), 128)) {
+  }
+  EXPECT_EQ(frames_read, kInputSize);
+}
+
+TEST(OfflineRubberBand, RendersInterleavedPcm) {
+  auto input = createInput();
+  std::vector<int16_t> pcm(kInputSize * kChannelCount);
+  for (size_t i = 0; i < kInputSize; ++i) {
+    for (size_t channel = 0; channel < kChannelCount; ++channel) {
+      pcm[i * kChannelCount + channel] = static_cast<int16_t>(std::lrint(input[channel][i] * 32767.0f));
+      input[channel][i] = static_cast<float>(pcm[i * kChannelCount + channel]) / 32768.0f;
+    }
+  }
+  auto input_channels = pointers<const float>(input);
+
+  // Interleaved int16 in and out renders what planar float does, rounded to int16
+  OfflineRubberBand planar(kSampleRate, kChannelCount, 1.25, 1.1);
+  planar.setInput(input_channels.data(), kInputSize);
+  const size_t output_size = planar.getOutputSize();
+  std::vector<std::vector<float>> output(kChannelCount, std::vector<float>(output_size));
+  auto output_channels = pointers<float>(output);
+  ASSERT_EQ(planar.render(output_channels.data(), 0, output_size), output_size);
+  std::vector<int16_t> expected(output_size * kChannelCount);
+  interleavePcmScalar(output_channels.data(), 0, expected.data(), SampleFormat::kInt16, kChannelCount, output_size);
+
+  RubberBandProcessor processor(kSampleRate, kChannelCount, 1.25, 1.1);
+  ASSERT_EQ(processor.setInterleavedBuffer(reinterpret_cast<uintptr_t>(pcm.data()), kInputSize, SampleFormat::kInt16),
+            output_size);
+  std::vector<int16_t> actual(output_size * kChannelCount);
+  for (size_t position = 0; position < output_size; position += 3000) {
+    processor.retrieveInterleaved(reinterpret_cast<uintptr_t>(actual.data() + position * kChannelCount),
+                                  std::min<size_t>(3000, output_size - position), SampleFormat::kInt16);
+  }
+  EXPECT_EQ(actual, expected);
+
+  // RubberBandFinal converts pushed blocks straight into its input copy
+  RubberBandFinal final_planar(kSampleRate, kChannelCount, kInputSize, 1.25, 1.1);
+  RubberBandFinal final_interleaved(kSampleRate, kChannelCount, kInputSize, 1.25, 1.1);
+  final_planar.push(reinterpret_cast<uintptr_t>(input_channels.data()), kInputSize);
+  for (size_t position = 0; position < kInputSize; position += 4096) {
+    final_interleaved.pushInterleaved(reinterpret_cast<uintptr_t>(pcm.data() + position * kChannelCount),
+                                      std::min<size_t>(4096, kInputSize - position), SampleFormat::kInt16);
+  }
+  ASSERT_TRUE(final_planar.pull(reinterpret_cast<uintptr_t>(output_channels.data()), output_size));
+  std::vector<float> final_output(output_size * kChannelCount);
+  ASSERT_TRUE(final_interleaved.pullInterleaved(reinterpret_cast<uintptr_t>(final_output.data()), output_size,
+                                                SampleFormat::kFloat32));
+  for (size_t i = 0; i < output_size; i += 997) {
+    for (size_t channel = 0; channel < kChannelCount; ++channel) {
+      ASSERT_EQ(final_output[i * kChannelCount + channel], output[channel][i]) << i;
+    }
+  }
+}
@@ -0,0 +1,212 @@
+//
+// Offline rendering of one long input on several threads, for a constant time ratio and pitch scale.
+//
+
+#include "ParallelOfflineRubberBand.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "OfflineRubberBand.h"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define PARALLEL_OFFLINE_NO_THREADS
+#endif
+
+ParallelOfflineRubberBand::ParallelOfflineRubberBand(size_t sample_rate,
+                                                     size_t channel_count,
+                                                     double time_ratio,
+                                                     double pitch_scale,
+                                                     size_t thread_count)
+    : sample_rate_(sample_rate),
+      channel_count_(channel_count),
+      time_ratio_(time_ratio),
+      pitch_scale_(pitch_scale),
+      thread_count_(resolveThreadCount(thread_count)),
+      segment_size_(sample_rate * kSegmentMillis / 1000),
+      overlap_(sample_rate * kOverlapMillis / 1000) {
+}
+
+size_t ParallelOfflineRubberBand::resolveThreadCount(size_t thread_count) {
+#ifdef PARALLEL_OFFLINE_NO_THREADS
+  thread_count = 1;
+#else
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+#endif
+  return thread_count;
+}
+
+void ParallelOfflineRubberBand::setSegmentSize(size_t segment_size) {
+  segment_size_ = std::max<size_t>(segment_size, 1);
+}
+
+void ParallelOfflineRubberBand::setOverlap(size_t overlap) {
+  overlap_ = std::max<size_t>(overlap, 1);
+}
+
+size_t ParallelOfflineRubberBand::getThreadCount() const {
+  return thread_count_;
+}
+
+size_t ParallelOfflineRubberBand::getOutputSize(size_t input_size) const {
+  return toOutput(input_size);
+}
+
+size_t ParallelOfflineRubberBand::render(const float *const *input, size_t input_size, float *const *output) {
+  const size_t output_size = getOutputSize(input_size);
+  if (output_size == 0) {
+    return 0;
+  }
+
+  // Every segment has to be longer than the crossfades at both of its ends
+  const size_t segment_size = std::max(segment_size_, overlap_);
+  std::vector<Segment> segments;
+  for (size_t begin = 0; begin < input_size;) {
+    // A short remainder joins the last segment
+    const size_t end = input_size - begin < segment_size * 2 ? input_size : begin + segment_size;
+    segments.push_back({begin, end, {}, {}});
+    begin = end;
+  }
+
+  std::atomic<size_t> next_segment{0};
+  auto work = [&]() {
+    for (size_t index = next_segment++; index < segments.size(); index = next_segment++) {
+      renderSegment(segments[index], input, input_size, output, output_size);
+    }
+  };
+#ifdef PARALLEL_OFFLINE_NO_THREADS
+  work();
+#else
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min(thread_count_, segments.size()); ++i) {
+    workers.emplace_back(work);
+  }
+  work();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+#endif
+
+  // Raised cosine crossfade around every segment boundary. The segments' phases do not line up, so the
+  // gain is corrected for the correlation of both sides to keep the power constant through the fade.
+  for (size_t index = 1; index < segments.size(); ++index) {
+    const auto &fade_out = segments[index - 1].tail;
+    const auto &fade_in = segments[index].head;
+    const size_t fade_size = fade_in[0].size();
+    const size_t fade_begin = toOutput(segments[index].begin) - fade_size / 2;
+    const size_t frames = std::min(fade_size, output_size - fade_begin);
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      const double correlation = std::max(getCorrelation(fade_out[channel], fade_in[channel]), kMinCorrelation);
+      for (size_t i = 0; i < frames; ++i) {
+        const double weight = 0.5 - 0.5 * std::cos(M_PI * (i + 0.5) / fade_size);
+        const double out_gain = 1.0 - weight;
+        const double power = out_gain * out_gain + weight * weight + 2.0 * correlation * out_gain * weight;
+        const double gain = 1.0 / std::sqrt(power);
+        output[channel][fade_begin + i] =
+            static_cast<float>((fade_out[channel][i] * out_gain + fade_in[channel][i] * weight) * gain);
+      }
+    }
+  }
+  return output_size;
+}
+
+void ParallelOfflineRubberBand::renderSegment(Segment &segment,
+                                              const float *const *input,
+                                              size_t input_size,
+                                              float *const *output,
+                                              size_t output_size) const {
+  const size_t half_fade = std::max<size_t>(toOutput(overlap_) / 2, 1);
+  const bool first = segment.begin == 0;
+  const bool last = segment.end >= input_size;
+  const size_t render_begin = segment.begin - std::min(segment.begin, overlap_);
+  const size_t render_end = std::min(segment.end + overlap_, input_size);
+
+  // Output regions in the order the stretcher produces them: lead-in to drop, fade in, own frames, fade out
+  const size_t fade_in_begin = first ? 0 : toOutput(segment.begin) - half_fade;
+  const size_t own_begin = first ? 0 : fade_in_begin + half_fade * 2;
+  const size_t own_end = last ? output_size : toOutput(segment.end) - half_fade;
+  const size_t fade_out_end = last ? output_size : own_end + half_fade * 2;
+  if (!first) {
+    segment.head.assign(channel_count_, std::vector<float>(half_fade * 2));
+  }
+  if (!last) {
+    segment.tail.assign(channel_count_, std::vector<float>(half_fade * 2));
+  }
+
+  std::vector<const float *> segment_input(channel_count_);
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    segment_input[channel] = input[channel] + render_begin;
+  }
+  OfflineRubberBand rubber_band(sample_rate_, channel_count_, time_ratio_, pitch_scale_);
+  rubber_band.setInput(segment_input.data(), render_end - render_begin);
+
+  std::vector<std::vector<float>> discard(channel_count_, std::vector<float>(OfflineRubberBand::kChunkSize));
+  std::vector<float *> destination(channel_count_);
+  size_t position = toOutput(render_begin);
+  while (position < fade_out_end) {
+    size_t region_end;
+    size_t offset;
+    if (position < fade_in_begin) {
+      region_end = fade_in_begin;
+      for (size_t channel = 0; channel < channel_count_; ++channel) {
+        destination[channel] = discard[channel].data();
+      }
+      offset = 0;
+    } else if (position < own_begin) {
+      region_end = own_begin;
+      for (size_t channel = 0; channel < channel_count_; ++channel) {
+        destination[channel] = segment.head[channel].data();
+      }
+      offset = position - fade_in_begin;
+    } else if (position < own_end) {
+      region_end = own_end;
+      for (size_t channel = 0; channel < channel_count_; ++channel) {
+        destination[channel] = output[channel];
+      }
+      offset = position;
+    } else {
+      region_end = fade_out_end;
+      for (size_t channel = 0; channel < channel_count_; ++channel) {
+        destination[channel] = segment.tail[channel].data();
+      }
+      offset = position - own_end;
+    }
+    size_t frames = region_end - position;
+    if (position < fade_in_begin) {
+      frames = std::min(frames, OfflineRubberBand::kChunkSize);
+    }
+    const size_t rendered = rubber_band.render(destination.data(), offset, frames);
+    if (rendered == 0) {
+      break;
+    }
+    position += rendered;
+  }
+
+  // The stretcher may end a frame early, the fade buffers are zeroed already
+  for (position = std::max(position, own_begin); position < own_end; ++position) {
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      output[channel][position] = 0.0f;
+    }
+  }
+}
+
+double ParallelOfflineRubberBand::getCorrelation(const std::vector<float> &a, const std::vector<float> &b) {
+  double product = 0.0;
+  double energy_a = 0.0;
+  double energy_b = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    product += static_cast<double>(a[i]) * b[i];
+    energy_a += static_cast<double>(a[i]) * a[i];
+    energy_b += static_cast<double>(b[i]) * b[i];
+  }
+  if (energy_a <= 0.0 || energy_b <= 0.0) {
+    return 1.0;
+  }
+  return product / std::sqrt(energy_a * energy_b);
+}
+
+size_t ParallelOfflineRubberBand::toOutput(size_t input_frame) const {
+  return std::lround(static_cast<double>(input_frame) * time_ratio_);
+}
@@ -0,0 +1,70 @@
+//
+// Offline rendering of one long input on several threads, for a constant time ratio and pitch scale.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_PARALLELOFFLINERUBBERBAND_H_
+#define WASM_SRC_RUBBERBAND_PARALLELOFFLINERUBBERBAND_H_
+
+#include <cstddef>
+#include <vector>
+
+// Splits the input into segments that overlap their neighbours, renders every segment with its own
+// OfflineRubberBand on a worker thread and crossfades the segments where they meet. Offline stretchers
+// compensate their latency, so output frame round(input frame * time ratio) lines up in all segments.
+// Builds without threads (wasm without pthreads) render the segments one after the other.
+class ParallelOfflineRubberBand {
+ public:
+  static const size_t kSegmentMillis = 10000;
+  static const size_t kOverlapMillis = 200;
+  // Lower bound for the crossfade correlation, limits the gain boost for sides that cancel out
+  static constexpr double kMinCorrelation = -0.5;
+
+  // thread_count 0 uses every core
+  ParallelOfflineRubberBand(size_t sample_rate,
+                            size_t channel_count,
+                            double time_ratio = 1.0,
+                            double pitch_scale = 1.0,
+                            size_t thread_count = 0);
+
+  // Input frames per segment (without the overlap), the default is kSegmentMillis
+  void setSegmentSize(size_t segment_size);
+
+  // Input frames every segment renders beyond its boundaries, the default is kOverlapMillis
+  void setOverlap(size_t overlap);
+
+  [[nodiscard]] size_t getThreadCount() const;
+
+  // Threads a render actually uses for the requested count: every core for 0, 1 in builds without threads
+  [[nodiscard]] static size_t resolveThreadCount(size_t thread_count);
+
+  [[nodiscard]] size_t getOutputSize(size_t input_size) const;
+
+  // Renders the planar input into the planar output, which has to hold getOutputSize(input_size) frames.
+  // Returns the frames written.
+  size_t render(const float *const *input, size_t input_size, float *const *output);
+
+ private:
+  struct Segment {
+    size_t begin;  // first input frame owned by the segment
+    size_t end;
+    // Output frames of the crossfade into the next segment, per channel, and of the fade in from the previous
+    std::vector<std::vector<float>> tail;
+    std::vector<std::vector<float>> head;
+  };
+
+  void renderSegment(Segment &segment, const float *const *input, size_t input_size, float *const *output,
+                     size_t output_size) const;
+  [[nodiscard]] size_t toOutput(size_t input_frame) const;
+  // Normalized cross-correlation of both sides of a crossfade
+  static double getCorrelation(const std::vector<float> &a, const std::vector<float> &b);
+
+  size_t sample_rate_;
+  size_t channel_count_;
+  double time_ratio_;
+  double pitch_scale_;
+  size_t thread_count_;
+  size_t segment_size_;
+  size_t overlap_;
+};
+
+#endif //WASM_SRC_RUBBERBAND_PARALLELOFFLINERUBBERBAND_H_
@@ -0,0 +1,38 @@
+//
+// Single-producer/single-consumer mailbox for stretcher parameters.
+//
+
+#include "ParameterMailbox.h"
+
+ParameterMailbox::ParameterMailbox() : pending_(0) {
+  for (auto &value : values_) {
+    value.store(0.0, std::memory_order_relaxed);
+  }
+}
+
+void ParameterMailbox::seed(Parameter parameter, double value) {
+  values_[parameter].store(value, std::memory_order_release);
+}
+
+void ParameterMailbox::post(Parameter parameter, double value) {
+  values_[parameter].store(value, std::memory_order_relaxed);
+  pending_.fetch_or(1u << parameter, std::memory_order_release);
+}
+
+bool ParameterMailbox::take(Parameter parameter, double &value) {
+  const uint32_t bit = 1u << parameter;
+  if (!(pending_.fetch_and(~bit, std::memory_order_acquire) & bit)) {
+    return false;
+  }
+  // A post() racing with this read sets the bit again, so the newer value is picked up next block
+  value = values_[parameter].load(std::memory_order_relaxed);
+  return true;
+}
+
+double ParameterMailbox::peek(Parameter parameter) const {
+  return values_[parameter].load(std::memory_order_acquire);
+}
+
+bool ParameterMailbox::hasPending() const {
+  return pending_.load(std::memory_order_relaxed) != 0;
+}
@@ -0,0 +1,44 @@
+//
+// Single-producer/single-consumer mailbox for stretcher parameters.
+//
+// The control thread posts values without blocking, the audio thread takes only the latest value
+// of each parameter at the next block boundary.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_PARAMETERMAILBOX_H_
+#define WASM_SRC_RUBBERBAND_PARAMETERMAILBOX_H_
+
+#include <atomic>
+#include <cstdint>
+
+class ParameterMailbox {
+ public:
+  enum Parameter {
+    kTempo = 0,
+    kPitch,
+    kFormantScale,
+    kParameterCount
+  };
+
+  ParameterMailbox();
+
+  // Sets the value without marking it pending, used to start from what the stretcher already has
+  void seed(Parameter parameter, double value);
+
+  // Control thread: overwrites any value of this parameter that has not been taken yet
+  void post(Parameter parameter, double value);
+
+  // Audio thread: true and the latest value if the parameter has been posted since the last take
+  bool take(Parameter parameter, double &value);
+
+  // Any thread: the latest posted (or seeded) value, whether or not it has been taken yet
+  [[nodiscard]] double peek(Parameter parameter) const;
+
+  [[nodiscard]] bool hasPending() const;
+
+ private:
+  std::atomic<double> values_[kParameterCount];
+  std::atomic<uint32_t> pending_;
+};
+
+#endif //WASM_SRC_RUBBERBAND_PARAMETERMAILBOX_H_
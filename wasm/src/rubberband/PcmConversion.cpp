@@ -0,0 +1,293 @@
+//
+// Interleaved PCM in integer or float formats to and from planar float, converted while copying.
+//
+// 16 bit mono and stereo, what decoders mostly deliver, convert and (de-)interleave in the same wasm simd128 or
+// SSE2 registers. Float goes through the interleave kernels, the other formats through a fused scalar loop.
+//
+
+#include "PcmConversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "Interleave.h"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define PCM_SIMD128 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PCM_SSE2 1
+#endif
+
+namespace {
+
+const float kInt16Scale = 32768.0f;
+const float kInt24Scale = 8388608.0f;
+const double kInt32Scale = 2147483648.0;
+
+// Clips like the vector code (max(-1, x) first, so NaN ends up at -1)
+float clip(float sample) {
+  sample = sample > -1.0f ? sample : -1.0f;
+  return sample < 1.0f ? sample : 1.0f;
+}
+
+template<SampleFormat kFormat>
+float readSample(const uint8_t *source) {
+  if constexpr (kFormat == SampleFormat::kInt16) {
+    int16_t value;
+    std::memcpy(&value, source, sizeof(value));
+    return static_cast<float>(value) / kInt16Scale;
+  } else if constexpr (kFormat == SampleFormat::kInt24) {
+    // Shift into the top bytes so the sign extends
+    const uint32_t bits = (static_cast<uint32_t>(source[0]) << 8) | (static_cast<uint32_t>(source[1]) << 16) |
+        (static_cast<uint32_t>(source[2]) << 24);
+    return static_cast<float>(static_cast<int32_t>(bits) >> 8) / kInt24Scale;
+  } else if constexpr (kFormat == SampleFormat::kInt32) {
+    int32_t value;
+    std::memcpy(&value, source, sizeof(value));
+    return static_cast<float>(value / kInt32Scale);
+  } else {
+    float value;
+    std::memcpy(&value, source, sizeof(value));
+    return value;
+  }
+}
+
+template<SampleFormat kFormat>
+void writeSample(float sample, uint8_t *destination) {
+  if constexpr (kFormat == SampleFormat::kInt16) {
+    const auto value = static_cast<int16_t>(std::min(std::lrint(clip(sample) * kInt16Scale), 32767L));
+    std::memcpy(destination, &value, sizeof(value));
+  } else if constexpr (kFormat == SampleFormat::kInt24) {
+    const auto value = static_cast<int32_t>(std::min(std::lrint(clip(sample) * kInt24Scale), 8388607L));
+    destination[0] = static_cast<uint8_t>(value);
+    destination[1] = static_cast<uint8_t>(value >> 8);
+    destination[2] = static_cast<uint8_t>(value >> 16);
+  } else if constexpr (kFormat == SampleFormat::kInt32) {
+    const auto value = static_cast<int32_t>(std::min(std::llrint(clip(sample) * kInt32Scale), 2147483647LL));
+    std::memcpy(destination, &value, sizeof(value));
+  } else {
+    std::memcpy(destination, &sample, sizeof(sample));
+  }
+}
+
+// One loop per format, so the format is not looked at per sample
+template<SampleFormat kFormat>
+void deinterleaveLoop(const uint8_t *source, float *const *destination, size_t offset, size_t channel_count,
+                      size_t frame_count) {
+  const size_t sample_size = getBytesPerSample(kFormat);
+  for (size_t i = 0; i < frame_count; ++i) {
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      destination[channel][offset + i] = readSample<kFormat>(source);
+      source += sample_size;
+    }
+  }
+}
+
+template<SampleFormat kFormat>
+void interleaveLoop(const float *const *source, size_t offset, uint8_t *destination, size_t channel_count,
+                    size_t frame_count) {
+  const size_t sample_size = getBytesPerSample(kFormat);
+  for (size_t i = 0; i < frame_count; ++i) {
+    for (size_t channel = 0; channel < channel_count; ++channel) {
+      writeSample<kFormat>(source[channel][offset + i], destination);
+      destination += sample_size;
+    }
+  }
+}
+
+#if defined(PCM_SIMD128)
+
+size_t deinterleaveInt16(const int16_t *source, float *const *destination, size_t offset, size_t channel_count,
+                         size_t frame_count) {
+  const v128_t scale = wasm_f32x4_splat(1.0f / kInt16Scale);
+  size_t i = 0;
+  if (channel_count == 1) {
+    for (; i + 8 <= frame_count; i += 8) {
+      const v128_t samples = wasm_v128_load(source + i);
+      const v128_t lo = wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8(samples));
+      const v128_t hi = wasm_f32x4_convert_i32x4(wasm_i32x4_extend_high_i16x8(samples));
+      wasm_v128_store(destination[0] + offset + i, wasm_f32x4_mul(lo, scale));
+      wasm_v128_store(destination[0] + offset + i + 4, wasm_f32x4_mul(hi, scale));
+    }
+  } else if (channel_count == 2) {
+    for (; i + 4 <= frame_count; i += 4) {
+      const v128_t samples = wasm_v128_load(source + i * 2);
+      const v128_t lo = wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8(samples)), scale);
+      const v128_t hi = wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_high_i16x8(samples)), scale);
+      wasm_v128_store(destination[0] + offset + i, wasm_i32x4_shuffle(lo, hi, 0, 2, 4, 6));
+      wasm_v128_store(destination[1] + offset + i, wasm_i32x4_shuffle(lo, hi, 1, 3, 5, 7));
+    }
+  }
+  return i;
+}
+
+v128_t toInt32(v128_t samples) {
+  const v128_t clipped = wasm_f32x4_pmin(wasm_f32x4_splat(1.0f), wasm_f32x4_pmax(wasm_f32x4_splat(-1.0f), samples));
+  return wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_nearest(wasm_f32x4_mul(clipped, wasm_f32x4_splat(kInt16Scale))));
+}
+
+size_t interleaveInt16(const float *const *source, size_t offset, int16_t *destination, size_t channel_count,
+                       size_t frame_count) {
+  size_t i = 0;
+  if (channel_count == 1) {
+    for (; i + 8 <= frame_count; i += 8) {
+      const v128_t lo = toInt32(wasm_v128_load(source[0] + offset + i));
+      const v128_t hi = toInt32(wasm_v128_load(source[0] + offset + i + 4));
+      wasm_v128_store(destination + i, wasm_i16x8_narrow_i32x4(lo, hi));
+    }
+  } else if (channel_count == 2) {
+    for (; i + 4 <= frame_count; i += 4) {
+      const v128_t left = wasm_v128_load(source[0] + offset + i);
+      const v128_t right = wasm_v128_load(source[1] + offset + i);
+      const v128_t lo = toInt32(wasm_i32x4_shuffle(left, right, 0, 4, 1, 5));
+      const v128_t hi = toInt32(wasm_i32x4_shuffle(left, right, 2, 6, 3, 7));
+      wasm_v128_store(destination + i * 2, wasm_i16x8_narrow_i32x4(lo, hi));
+    }
+  }
+  return i;
+}
+
+#elif defined(PCM_SSE2)
+
+// Sign extends by moving every 16 bit sample into the top half of a 32 bit lane
+__m128 lowToFloat(__m128i samples, __m128 scale) {
+  return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16)), scale);
+}
+
+__m128 highToFloat(__m128i samples, __m128 scale) {
+  return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16)), scale);
+}
+
+size_t deinterleaveInt16(const int16_t *source, float *const *destination, size_t offset, size_t channel_count,
+                         size_t frame_count) {
+  const __m128 scale = _mm_set1_ps(1.0f / kInt16Scale);
+  size_t i = 0;
+  if (channel_count == 1) {
+    for (; i + 8 <= frame_count; i += 8) {
+      const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+      _mm_storeu_ps(destination[0] + offset + i, lowToFloat(samples, scale));
+      _mm_storeu_ps(destination[0] + offset + i + 4, highToFloat(samples, scale));
+    }
+  } else if (channel_count == 2) {
+    for (; i + 4 <= frame_count; i += 4) {
+      const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 2));
+      const __m128 lo = lowToFloat(samples, scale);
+      const __m128 hi = highToFloat(samples, scale);
+      _mm_storeu_ps(destination[0] + offset + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(destination[1] + offset + i, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+  }
+  return i;
+}
+
+// Rounds to nearest (the default MXCSR mode); packing saturates 32768 to 32767
+__m128i toInt32(__m128 samples) {
+  const __m128 clipped = _mm_min_ps(_mm_max_ps(samples, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+  return _mm_cvtps_epi32(_mm_mul_ps(clipped, _mm_set1_ps(kInt16Scale)));
+}
+
+size_t interleaveInt16(const float *const *source, size_t offset, int16_t *destination, size_t channel_count,
+                       size_t frame_count) {
+  size_t i = 0;
+  if (channel_count == 1) {
+    for (; i + 8 <= frame_count; i += 8) {
+      const __m128i lo = toInt32(_mm_loadu_ps(source[0] + offset + i));
+      const __m128i hi = toInt32(_mm_loadu_ps(source[0] + offset + i + 4));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm_packs_epi32(lo, hi));
+    }
+  } else if (channel_count == 2) {
+    for (; i + 4 <= frame_count; i += 4) {
+      const __m128 left = _mm_loadu_ps(source[0] + offset + i);
+      const __m128 right = _mm_loadu_ps(source[1] + offset + i);
+      const __m128i lo = toInt32(_mm_unpacklo_ps(left, right));
+      const __m128i hi = toInt32(_mm_unpackhi_ps(left, right));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 2), _mm_packs_epi32(lo, hi));
+    }
+  }
+  return i;
+}
+
+#endif
+
+}  // namespace
+
+size_t getBytesPerSample(SampleFormat sample_format) {
+  switch (sample_format) {
+    case SampleFormat::kInt16:
+      return 2;
+    case SampleFormat::kInt24:
+      return 3;
+    case SampleFormat::kInt32:
+    case SampleFormat::kFloat32:
+      return 4;
+  }
+  return 4;
+}
+
+void deinterleavePcmScalar(const void *source, SampleFormat sample_format, float *const *destination, size_t offset,
+                           size_t channel_count, size_t frame_count) {
+  const auto *bytes = static_cast<const uint8_t *>(source);
+  switch (sample_format) {
+    case SampleFormat::kInt16:
+      return deinterleaveLoop<SampleFormat::kInt16>(bytes, destination, offset, channel_count, frame_count);
+    case SampleFormat::kInt24:
+      return deinterleaveLoop<SampleFormat::kInt24>(bytes, destination, offset, channel_count, frame_count);
+    case SampleFormat::kInt32:
+      return deinterleaveLoop<SampleFormat::kInt32>(bytes, destination, offset, channel_count, frame_count);
+    case SampleFormat::kFloat32:
+      return deinterleaveLoop<SampleFormat::kFloat32>(bytes, destination, offset, channel_count, frame_count);
+  }
+}
+
+void interleavePcmScalar(const float *const *source, size_t offset, void *destination, SampleFormat sample_format,
+                         size_t channel_count, size_t frame_count) {
+  auto *bytes = static_cast<uint8_t *>(destination);
+  switch (sample_format) {
+    case SampleFormat::kInt16:
+      return interleaveLoop<SampleFormat::kInt16>(source, offset, bytes, channel_count, frame_count);
+    case SampleFormat::kInt24:
+      return interleaveLoop<SampleFormat::kInt24>(source, offset, bytes, channel_count, frame_count);
+    case SampleFormat::kInt32:
+      return interleaveLoop<SampleFormat::kInt32>(source, offset, bytes, channel_count, frame_count);
+    case SampleFormat::kFloat32:
+      return interleaveLoop<SampleFormat::kFloat32>(source, offset, bytes, channel_count, frame_count);
+  }
+}
+
+void deinterleavePcm(const void *source, SampleFormat sample_format, float *const *destination, size_t offset,
+                     size_t channel_count, size_t frame_count) {
+  const bool aligned = reinterpret_cast<uintptr_t>(source) % getBytesPerSample(sample_format) == 0;
+  if (sample_format == SampleFormat::kFloat32 && aligned) {
+    deinterleave(static_cast<const float *>(source), destination, offset, channel_count, frame_count);
+    return;
+  }
+  size_t done = 0;
+#if defined(PCM_SIMD128) || defined(PCM_SSE2)
+  if (sample_format == SampleFormat::kInt16 && aligned) {
+    done = deinterleaveInt16(static_cast<const int16_t *>(source), destination, offset, channel_count, frame_count);
+  }
+#endif
+  deinterleavePcmScalar(static_cast<const uint8_t *>(source) + done * channel_count * getBytesPerSample(sample_format),
+                        sample_format, destination, offset + done, channel_count, frame_count - done);
+}
+
+void interleavePcm(const float *const *source, size_t offset, void *destination, SampleFormat sample_format,
+                   size_t channel_count, size_t frame_count) {
+  const bool aligned = reinterpret_cast<uintptr_t>(destination) % getBytesPerSample(sample_format) == 0;
+  if (sample_format == SampleFormat::kFloat32 && aligned) {
+    interleave(source, offset, static_cast<float *>(destination), channel_count, frame_count);
+    return;
+  }
+  size_t done = 0;
+#if defined(PCM_SIMD128) || defined(PCM_SSE2)
+  if (sample_format == SampleFormat::kInt16 && aligned) {
+    done = interleaveInt16(source, offset, static_cast<int16_t *>(destination), channel_count, frame_count);
+  }
+#endif
+  interleavePcmScalar(source, offset + done,
+                      static_cast<uint8_t *>(destination) + done * channel_count * getBytesPerSample(sample_format),
+                      sample_format, channel_count, frame_count - done);
+}
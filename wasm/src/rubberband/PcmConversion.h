@@ -0,0 +1,36 @@
+//
+// Interleaved PCM in integer or float formats to and from planar float, converted while copying.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_PCMCONVERSION_H_
+#define WASM_SRC_RUBBERBAND_PCMCONVERSION_H_
+
+#include <cstddef>
+
+// Little-endian interleaved samples. Integers map to [-1, 1) by dividing by 2^(bits - 1).
+enum class SampleFormat {
+  kInt16,
+  kInt24,
+  kInt32,
+  kFloat32,
+};
+
+[[nodiscard]] size_t getBytesPerSample(SampleFormat sample_format);
+
+// Converts frame_count interleaved frames from source to destination[channel][offset + i]
+void deinterleavePcm(const void *source, SampleFormat sample_format, float *const *destination, size_t offset,
+                     size_t channel_count, size_t frame_count);
+
+// Converts frame_count frames from source[channel][offset + i] to interleaved destination. Integer formats are
+// rounded to nearest and clipped to their range, NaN becomes the lowest value.
+void interleavePcm(const float *const *source, size_t offset, void *destination, SampleFormat sample_format,
+                   size_t channel_count, size_t frame_count);
+
+// Plain loops without vectorization, used as reference by tests and benchmarks
+void deinterleavePcmScalar(const void *source, SampleFormat sample_format, float *const *destination, size_t offset,
+                           size_t channel_count, size_t frame_count);
+
+void interleavePcmScalar(const float *const *source, size_t offset, void *destination, SampleFormat sample_format,
+                         size_t channel_count, size_t frame_count);
+
+#endif //WASM_SRC_RUBBERBAND_PCMCONVERSION_H_
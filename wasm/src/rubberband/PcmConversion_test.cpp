@@ -0,0 +1,115 @@
+//
+// PCM conversion kernels against the scalar reference, for every format, channel count and odd lengths.
+//
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "PcmConversion.h"
+
+namespace {
+
+const SampleFormat kFormats[] = {SampleFormat::kInt16, SampleFormat::kInt24, SampleFormat::kInt32,
+                                 SampleFormat::kFloat32};
+
+std::vector<float *> pointers(std::vector<std::vector<float>> &buffers) {
+  std::vector<float *> result;
+  for (auto &buffer : buffers) {
+    result.push_back(buffer.data());
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(PcmConversion, DeinterleaveMatchesScalar) {
+  for (const auto sample_format : kFormats) {
+    for (size_t channel_count : {1, 2, 3, 6}) {
+      for (size_t frame_count : {0, 1, 3, 4, 7, 8, 17, 129}) {
+        // Any bit pattern is a valid integer sample; floats stay finite so the comparison means something
+        std::vector<uint8_t> source(frame_count * channel_count * getBytesPerSample(sample_format));
+        for (size_t i = 0; i < source.size(); ++i) {
+          source[i] = static_cast<uint8_t>(i * 97 + 13);
+        }
+        if (sample_format == SampleFormat::kFloat32) {
+          for (size_t i = 0; i < source.size() / sizeof(float); ++i) {
+            const float value = static_cast<float>(i % 11) / 5.0f - 1.0f;
+            std::memcpy(source.data() + i * sizeof(float), &value, sizeof(value));
+          }
+        }
+        std::vector<std::vector<float>> expected(channel_count, std::vector<float>(frame_count + 2, -2.0f));
+        std::vector<std::vector<float>> actual(channel_count, std::vector<float>(frame_count + 2, -2.0f));
+        deinterleavePcmScalar(source.data(), sample_format, pointers(expected).data(), 2, channel_count, frame_count);
+        deinterleavePcm(source.data(), sample_format, pointers(actual).data(), 2, channel_count, frame_count);
+        EXPECT_EQ(actual, expected) << static_cast<int>(sample_format) << " " << channel_count << " " << frame_count;
+      }
+    }
+  }
+}
+
+TEST(PcmConversion, InterleaveMatchesScalar) {
+  // Out of range, NaN and exact halves between integer steps, which round to even
+  const float special[] = {1.5f, -1.5f, 1.0f, -1.0f, std::numeric_limits<float>::quiet_NaN(), 0.5f / 32768.0f,
+                           1.5f / 32768.0f, -0.5f / 32768.0f, 0.0f};
+  for (const auto sample_format : kFormats) {
+    for (size_t channel_count : {1, 2, 3, 6}) {
+      for (size_t frame_count : {0, 1, 3, 4, 7, 8, 17, 129}) {
+        std::vector<std::vector<float>> source(channel_count, std::vector<float>(frame_count + 1));
+        for (size_t channel = 0; channel < channel_count; ++channel) {
+          for (size_t i = 0; i < frame_count + 1; ++i) {
+            source[channel][i] = i % 3 == 0 ? special[(i + channel) % 9] : static_cast<float>(i * 37 % 101) / 50.0f - 1.0f;
+          }
+        }
+        const size_t byte_count = frame_count * channel_count * getBytesPerSample(sample_format);
+        std::vector<uint8_t> expected(byte_count);
+        std::vector<uint8_t> actual(byte_count);
+        auto source_channels = pointers(source);
+        interleavePcmScalar(source_channels.data(), 1, expected.data(), sample_format, channel_count, frame_count);
+        interleavePcm(source_channels.data(), 1, actual.data(), sample_format, channel_count, frame_count);
+        if (sample_format == SampleFormat::kFloat32) {
+          // NaN compares unequal as float, but the bits are copied
+          EXPECT_EQ(std::memcmp(actual.data(), expected.data(), byte_count), 0);
+        } else {
+          EXPECT_EQ(actual, expected) << static_cast<int>(sample_format) << " " << channel_count << " " << frame_count;
+        }
+      }
+    }
+  }
+}
+
+TEST(PcmConversion, Int16RoundTripsExactly) {
+  std::vector<int16_t> source(65536);
+  for (size_t i = 0; i < source.size(); ++i) {
+    source[i] = static_cast<int16_t>(i - 32768);
+  }
+  for (size_t channel_count : {1, 2}) {
+    const size_t frame_count = source.size() / channel_count;
+    std::vector<std::vector<float>> planar(channel_count, std::vector<float>(frame_count));
+    auto channels = pointers(planar);
+    deinterleavePcm(source.data(), SampleFormat::kInt16, channels.data(), 0, channel_count, frame_count);
+    EXPECT_EQ(planar[0][0], -1.0f);
+    std::vector<int16_t> output(source.size());
+    interleavePcm(channels.data(), 0, output.data(), SampleFormat::kInt16, channel_count, frame_count);
+    EXPECT_EQ(output, source);
+  }
+}
+
+TEST(PcmConversion, ClipsToIntegerRange) {
+  std::vector<float> samples = {1.5f, 1.0f, -1.5f, -1.0f, std::numeric_limits<float>::quiet_NaN(), 0.25f, 0.0f, 0.0f};
+  float *channels[] = {samples.data()};
+  std::vector<int16_t> int16(samples.size());
+  interleavePcm(channels, 0, int16.data(), SampleFormat::kInt16, 1, samples.size());
+  EXPECT_EQ(int16, (std::vector<int16_t>{32767, 32767, -32768, -32768, -32768, 8192, 0, 0}));
+
+  uint8_t int24[3];
+  interleavePcm(channels, 0, int24, SampleFormat::kInt24, 1, 1);
+  EXPECT_EQ(int24[0], 0xFF);
+  EXPECT_EQ(int24[1], 0xFF);
+  EXPECT_EQ(int24[2], 0x7F);
+
+  int32_t int32[3];
+  interleavePcm(channels, 0, int32, SampleFormat::kInt32, 1, 3);
+  EXPECT_EQ(int32[0], std::numeric_limits<int32_t>::max());
+  EXPECT_EQ(int32[2], std::numeric_limits<int32_t>::min());
+}
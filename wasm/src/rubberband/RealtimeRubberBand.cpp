@@ -3,8 +3,17 @@
 //
 
 #include "RealtimeRubberBand.h"
+#include "DenormalGuard.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#ifdef __EMSCRIPTEN__
+#include "ExternalAudioRing.h"
+#endif
+
+static_assert(sizeof(std::atomic<uint32_t>) * RealtimeRubberBand::kCounterCount == 16,
+              "Counters must map onto a Uint32Array");
 
 const RubberBand::RubberBandStretcher::Options kDefaultOption = RubberBand::RubberBandStretcher::OptionProcessRealTime |
   RubberBand::RubberBandStretcher::OptionPitchHighConsistency |
@@ -15,19 +24,28 @@ const RubberBand::RubberBandStretcher::Options kHighQuality = RubberBand::Rubber
   RubberBand::RubberBandStretcher::OptionEngineFiner |
   RubberBand::RubberBandStretcher::OptionWindowLong |
   RubberBand::RubberBandStretcher::OptionSmoothingOn;
+// R3 ignores the window options in 3.0, so short windows mean the R2 engine
+const RubberBand::RubberBandStretcher::Options kLowLatency = RubberBand::RubberBandStretcher::OptionProcessRealTime |
+  RubberBand::RubberBandStretcher::OptionPitchHighConsistency |
+  RubberBand::RubberBandStretcher::OptionEngineFaster |
+  RubberBand::RubberBandStretcher::OptionWindowShort;
+// One render quantum
+const size_t kRenderQuantum = 128;
+const size_t kLowLatencyBlockSize = kRenderQuantum;
+// R2 needs a full analysis window (and more at small ratios) before its delay is covered
+const size_t kR2PrerollWindow = 1024;
+// Governor: weight of a new load measurement and the crossfade length (1/50 s) when switching engines
+const double kGovernorWeight = 1.0 / 8;
+const size_t kGovernorFadeDivisor = 50;
+// Output queued for pull() when nothing else is configured
+const double kDefaultHeadroomMillis = 250;
 
-RealtimeRubberBand::RealtimeRubberBand(size_t sampleRate, size_t channel_count, bool high_quality, bool formant_preserved, int transients, int detector, size_t block_size) :
+RealtimeRubberBand::RealtimeRubberBand(size_t sampleRate, size_t channel_count, bool high_quality, bool formant_preserved, int transients, int detector, size_t block_size, int profile) :
     start_pad_samples_(0),
     start_delay_samples_(0),
+  sample_rate_(sampleRate),
   channel_count_(channel_count),
-  block_size_(block_size > 0 ? block_size : 512),
-  input_audio_(emscripten::val::null()),
-  input_control_(emscripten::val::null()),
-  input_ring_size_(0),
-  output_audio_(emscripten::val::null()),
-  output_control_(emscripten::val::null()),
-  output_ring_size_(0),
-  sab_mode_(false) {
+  block_size_(block_size > 0 ? block_size : 512) {
   if (sampleRate <= 0) {
     throw std::range_error("Sample rate has to be greater than 0");
   }
@@ -37,6 +55,12 @@ RealtimeRubberBand::RealtimeRubberBand(size_t sampleRate, size_t channel_count,
   
   // Build options from parameters
   RubberBand::RubberBandStretcher::Options opts = high_quality ? kHighQuality : kDefaultOption;
+
+  // Low latency profile: short windows and at most one render quantum per block
+  if (profile == kProfileLowLatency) {
+    opts = kLowLatency;
+    block_size_ = std::min(block_size_, kLowLatencyBlockSize);
+  }
   
   // Add formant preservation
   if (formant_preserved) {
@@ -61,33 +85,56 @@ RealtimeRubberBand::RealtimeRubberBand(size_t sampleRate, size_t channel_count,
     opts |= RubberBand::RubberBandStretcher::OptionDetectorCompound;
   }
   
+  options_ = opts;
   stretcher_ = new RubberBand::RubberBandStretcher(sampleRate, channel_count, opts);
   stretcher_->setMaxProcessSize(block_size_);
-  output_buffer_ = new RubberBand::RingBuffer<float> *[channel_count_];
+  parameters_.seed(ParameterMailbox::kTempo, stretcher_->getTimeRatio());
+  parameters_.seed(ParameterMailbox::kPitch, stretcher_->getPitchScale());
+  parameters_.seed(ParameterMailbox::kFormantScale, stretcher_->getFormantScale());
+  // Output buffering: time ratios > 1.0 generate output faster than we consume, so the ring is sized
+  // for the largest ratio set so far and grows when a larger one comes in (see reserveOutput())
+  headroom_millis_ = kDefaultHeadroomMillis;
+  reserved_frames_ = getOutputFrames(1.0);
+  output_buffer_ = createOutputBuffer(reserved_frames_);
+  // Everything is retrieved from the stretcher one block at a time
   scratch_ = new float *[channel_count_];
-  // Output buffering: time ratios > 1.0 can generate output faster than we consume.
-  // Give ourselves a couple seconds of headroom to avoid constant backpressure.
-  buffer_size_ = std::max<size_t>(block_size_ + kReserve_ + 8192, sampleRate * 2);
   for (size_t channel = 0; channel < channel_count_; ++channel) {
-    output_buffer_[channel] = new RubberBand::RingBuffer<float>(buffer_size_);
-    scratch_[channel] = new float[buffer_size_];
+    scratch_[channel] = new float[block_size_];
   }
-  updateRatio();
+  // Everything push() needs on the audio thread is allocated up front
+  input_channels_ = new const float *[channel_count_];
+  staging_buffer_ = new float[channel_count_ * block_size_];
+  staging_ = new float *[channel_count_];
+  silence_buffer_ = new float[block_size_];
+  std::fill(silence_buffer_, silence_buffer_ + block_size_, 0.0f);
+  silence_ = new const float *[channel_count_];
+  std::fill(silence_, silence_ + channel_count_, silence_buffer_);
+  resetPositions();
 }
 
 RealtimeRubberBand::~RealtimeRubberBand() {
-  if (output_buffer_) {
+  setRings(nullptr, nullptr);
+  deleteOutputBuffer(output_buffer_);
+  deleteOutputBuffer(pending_output_buffer_.load());
+  deleteOutputBuffer(retired_output_buffer_.load());
+  if (scratch_) {
     for (size_t channel = 0; channel < channel_count_; ++channel) {
-      delete output_buffer_[channel];
+      delete[] scratch_[channel];
     }
   }
-  if (scratch_) {
+  if (standby_scratch_) {
     for (size_t channel = 0; channel < channel_count_; ++channel) {
-      delete[] scratch_[channel];
+      delete[] standby_scratch_[channel];
     }
   }
-  delete[] output_buffer_;
   delete[] scratch_;
+  delete[] standby_scratch_;
+  delete standby_;
+  delete[] input_channels_;
+  delete[] staging_buffer_;
+  delete[] staging_;
+  delete[] silence_;
+  delete[] silence_buffer_;
   delete stretcher_;
 }
 
@@ -99,37 +146,185 @@ void RealtimeRubberBand::setTempo(double tempo) {
   if (tempo <= 0) {
     throw std::range_error("Tempo has to be greater than 0");
   }
-  if (stretcher_->getTimeRatio() != tempo) {
-    fetchProcessed();
-    stretcher_->setTimeRatio(tempo);
-    stretcher_->setMaxProcessSize(block_size_);
-    // In realtime mode we do not want to reintroduce a startup delay/pad
-    // when the ratio changes. RubberBand handles ratio changes without gaps.
-    start_pad_samples_ = 0;
-    start_delay_samples_ = 0;
+  reserveOutput(tempo);
+  parameters_.post(ParameterMailbox::kTempo, tempo);
+}
+
+void RealtimeRubberBand::setMaxTimeRatio(double ratio) {
+  if (ratio <= 0) {
+    throw std::range_error("Time ratio has to be greater than 0");
+  }
+  reserveOutput(ratio);
+}
+
+void RealtimeRubberBand::setOutputHeadroom(double milliseconds) {
+  if (milliseconds < 0) {
+    throw std::range_error("Headroom must not be negative");
+  }
+  headroom_millis_ = milliseconds;
+  reserveOutput(max_time_ratio_);
+}
+
+size_t RealtimeRubberBand::getOutputCapacity() const {
+  return reserved_frames_;
+}
+
+size_t RealtimeRubberBand::getMemoryUsage() const {
+  const size_t float_size = sizeof(float);
+  // Output ring (RingBuffer keeps one slot free), retrieve scratch, staging and the silence block
+  size_t bytes = channel_count_ * (reserved_frames_ + 1) * float_size;
+  bytes += 2 * channel_count_ * block_size_ * float_size + block_size_ * float_size;
+  bytes += 4 * channel_count_ * sizeof(float *);
+  if (standby_scratch_) {
+    bytes += channel_count_ * block_size_ * float_size;
+  }
+  if (shared_input_ring_) {
+    bytes += shared_input_ring_->getFrameCount() * channel_count_ * float_size;
+  }
+  if (shared_output_ring_) {
+    bytes += shared_output_ring_->getFrameCount() * channel_count_ * float_size;
   }
+  return bytes;
+}
+
+size_t RealtimeRubberBand::getOutputFrames(double ratio) const {
+  // One block plus the headroom, both at the stretched rate, and a reserve for bursts of the stretcher
+  const double headroom_frames = headroom_millis_ * static_cast<double>(sample_rate_) / 1000.0;
+  return static_cast<size_t>(std::ceil(ratio * (static_cast<double>(block_size_) + headroom_frames))) + kReserve_;
+}
+
+RubberBand::RingBuffer<float> **RealtimeRubberBand::createOutputBuffer(size_t frame_count) const {
+  auto **buffer = new RubberBand::RingBuffer<float> *[channel_count_];
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    buffer[channel] = new RubberBand::RingBuffer<float>(static_cast<int>(frame_count));
+  }
+  return buffer;
+}
+
+void RealtimeRubberBand::deleteOutputBuffer(RubberBand::RingBuffer<float> **buffer) const {
+  if (!buffer) return;
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    delete buffer[channel];
+  }
+  delete[] buffer;
+}
+
+void RealtimeRubberBand::reserveOutput(double ratio) {
+  max_time_ratio_ = std::max(max_time_ratio_, ratio);
+  // Whatever the audio thread swapped out last time can go now
+  deleteOutputBuffer(retired_output_buffer_.exchange(nullptr));
+  const size_t frame_count = getOutputFrames(max_time_ratio_);
+  if (frame_count <= reserved_frames_) return;
+
+  // Allocated here on the caller thread, the audio thread swaps it in at the next block boundary
+  reserved_frames_ = frame_count;
+  deleteOutputBuffer(pending_output_buffer_.exchange(createOutputBuffer(frame_count)));
+}
+
+void RealtimeRubberBand::swapOutputBuffer() {
+  // The previous one has to be collected first, so at most one is retired at a time
+  if (!pending_output_buffer_.load(std::memory_order_relaxed) || retired_output_buffer_.load()) return;
+  RubberBand::RingBuffer<float> **next = pending_output_buffer_.exchange(nullptr);
+  if (!next) return;
+
+  // Carry over what was not pulled yet, a block at a time
+  size_t left = output_buffer_[0]->getReadSpace();
+  while (left > 0) {
+    const size_t chunk = std::min(left, block_size_);
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      output_buffer_[channel]->read(scratch_[channel], static_cast<int>(chunk));
+      next[channel]->write(scratch_[channel], static_cast<int>(chunk));
+    }
+    left -= chunk;
+  }
+  retired_output_buffer_.store(output_buffer_);
+  output_buffer_ = next;
 }
 
 void RealtimeRubberBand::setPitch(double pitch) {
   if (pitch <= 0) {
     throw std::range_error("Pitch has to be greater than 0");
   }
-  if (stretcher_->getPitchScale() != pitch) {
-    fetchProcessed();
-    stretcher_->setPitchScale(pitch);
-    stretcher_->setMaxProcessSize(block_size_);
-    updateRatio();
-  }
+  parameters_.post(ParameterMailbox::kPitch, pitch);
 }
 
 void RealtimeRubberBand::setFormantScale(double scale) {
   if (scale <= 0) {
     throw std::range_error("Format scale has to be greater than 0");
   }
-  if (stretcher_->getFormantScale() != scale) {
+  parameters_.post(ParameterMailbox::kFormantScale, scale);
+}
+
+size_t RealtimeRubberBand::getInputLatency() const {
+  return input_ring_ ? input_ring_->getReadSpace() : 0;
+}
+
+size_t RealtimeRubberBand::getBlockLatency() const {
+  return block_size_;
+}
+
+size_t RealtimeRubberBand::getStretcherLatency() const {
+  return stretcher_->getStartDelay();
+}
+
+size_t RealtimeRubberBand::getOutputLatency() const {
+  return output_ring_ ? output_ring_->getReadSpace() : output_buffer_[0]->getReadSpace();
+}
+
+size_t RealtimeRubberBand::getLatency() const {
+  return getInputLatency() + getBlockLatency() + getStretcherLatency() + getOutputLatency();
+}
+
+double RealtimeRubberBand::getTempo() const {
+  return parameters_.peek(ParameterMailbox::kTempo);
+}
+
+double RealtimeRubberBand::getPitch() const {
+  return parameters_.peek(ParameterMailbox::kPitch);
+}
+
+double RealtimeRubberBand::getFormantScale() const {
+  return parameters_.peek(ParameterMailbox::kFormantScale);
+}
+
+void RealtimeRubberBand::applyParameters() {
+  swapOutputBuffer();
+  if (!parameters_.hasPending()) return;
+
+  double tempo, pitch, scale;
+  const bool tempo_changed = parameters_.take(ParameterMailbox::kTempo, tempo) && stretcher_->getTimeRatio() != tempo;
+  const bool pitch_changed = parameters_.take(ParameterMailbox::kPitch, pitch) && stretcher_->getPitchScale() != pitch;
+  const bool scale_changed =
+      parameters_.take(ParameterMailbox::kFormantScale, scale) && stretcher_->getFormantScale() != scale;
+  if (!tempo_changed && !pitch_changed && !scale_changed) return;
+
+  // Hand out what was processed with the old parameters first
+  if (output_ring_) {
+    drainToOutputRing();
+  } else {
     fetchProcessed();
+  }
+  if (tempo_changed) {
+    stretcher_->setTimeRatio(tempo);
+    // In realtime mode we do not want to reintroduce a startup delay/pad
+    // when the ratio changes. RubberBand handles ratio changes without gaps.
+    start_pad_samples_ = 0;
+    start_delay_samples_ = 0;
+  }
+  if (pitch_changed) {
+    stretcher_->setPitchScale(pitch);
+  }
+  if (scale_changed) {
     stretcher_->setFormantScale(scale);
-    stretcher_->setMaxProcessSize(block_size_);
+  }
+  // Both engines play during a switch
+  if (governor_.switching) {
+    standby_->setTimeRatio(stretcher_->getTimeRatio());
+    standby_->setPitchScale(stretcher_->getPitchScale());
+    standby_->setFormantScale(stretcher_->getFormantScale());
+  }
+  stretcher_->setMaxProcessSize(block_size_);
+  if (pitch_changed || scale_changed) {
     updateRatio();
   }
 }
@@ -138,32 +333,58 @@ __attribute__((unused)) size_t RealtimeRubberBand::getSamplesAvailable() {
   return output_buffer_[0]->getReadSpace();
 }
 
-void RealtimeRubberBand::push(uintptr_t input_ptr, size_t sample_size) {
+bool RealtimeRubberBand::push(uintptr_t input_ptr, size_t sample_size) {
+  DenormalGuard denormal_guard;
+  if (!telemetry_enabled_) return pushInput(input_ptr, sample_size);
+  const auto begin = std::chrono::steady_clock::now();
+  const bool accepted = pushInput(input_ptr, sample_size);
+  recordTelemetry(begin, accepted ? sample_size : 0);
+  return accepted;
+}
+
+bool RealtimeRubberBand::pushInput(uintptr_t input_ptr, size_t sample_size) {
   auto *input = reinterpret_cast<float *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
-  auto **arr_to_process = new float *[channel_count_];
+  if (draining_) return false;
+  const auto begin = governor_.enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  applyParameters();
 
-  if (start_pad_samples_ > 0) {
-    // Fill with start pad samples first
-    auto **empty = new float *[channel_count_];
-    for (size_t channel = 0; channel < channel_count_; ++channel) {
-      empty[channel] = new float[start_pad_samples_];
-      std::fill(empty[channel], empty[channel] + start_pad_samples_, 0.0f);
+  // With backpressure, refuse input as long as processed output is waiting for pull()
+  if (!fetchProcessed()) {
+    return false;
+  }
+
+  feedStartPad();
+
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    input_channels_[channel] = input + channel * sample_size;
+  }
+  if (gateSilence(input_channels_, sample_size)) {
+    // The stretcher only holds silence by now: skip it and queue the zeros it would have produced
+    if (backpressure_ && output_buffer_[0]->getWriteSpace() < getGatedFrames(sample_size)) {
+      counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+      return false;
     }
-    stretcher_->process(empty, start_pad_samples_, false);
+    const size_t frames = takeGatedFrames(sample_size);
+    size_t written = frames;
     for (size_t channel = 0; channel < channel_count_; ++channel) {
-      delete[] empty[channel];
+      written = output_buffer_[channel]->zero(static_cast<int>(frames));
     }
-    delete[] empty;
-    start_pad_samples_ = 0;
+    if (written < frames) {
+      counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+      counters_.dropped_frames.fetch_add(frames - written, std::memory_order_relaxed);
+    }
+    return true;
   }
-
-  for (size_t channel = 0; channel < channel_count_; ++channel) {
-    float *source = input + channel * sample_size;
-    arr_to_process[channel] = source;
+  stretcher_->process(input_channels_, sample_size, false);
+  if (governor_.switching) {
+    standby_->process(input_channels_, sample_size, false);
   }
-  stretcher_->process(arr_to_process, sample_size, false);
-  delete[] arr_to_process;
+  governor_.input_position += static_cast<double>(sample_size) * stretcher_->getTimeRatio();
   fetchProcessed();
+  if (governor_.enabled && !governor_.switching) {
+    updateGovernor(begin, sample_size);
+  }
+  return true;
 }
 
 __attribute__((unused)) void RealtimeRubberBand::pull(uintptr_t output_ptr, size_t sample_size) {
@@ -171,11 +392,14 @@ __attribute__((unused)) void RealtimeRubberBand::pull(uintptr_t output_ptr, size
   for (size_t channel = 0; channel < channel_count_; ++channel) {
     size_t available = output_buffer_[channel]->getReadSpace();
     float *destination = output + channel * sample_size;
+    const size_t to_read = std::min<size_t>(available, sample_size);
+    if (channel == 0 && to_read < sample_size) {
+      counters_.underrun_frames.fetch_add(sample_size - to_read, std::memory_order_relaxed);
+    }
     if (available == 0) {
       std::fill(destination, destination + sample_size, 0.0f);
       continue;
     }
-    const size_t to_read = std::min<size_t>(available, sample_size);
     output_buffer_[channel]->read(destination, to_read);
     if (to_read < sample_size) {
       std::fill(destination + to_read, destination + sample_size, 0.0f);
@@ -183,164 +407,667 @@ __attribute__((unused)) void RealtimeRubberBand::pull(uintptr_t output_ptr, size
   }
 }
 
-void RealtimeRubberBand::fetchProcessed() {
+bool RealtimeRubberBand::pushInterleaved(uintptr_t input_ptr, size_t sample_size, SampleFormat sample_format) {
+  const auto *input = reinterpret_cast<const void *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
+  deinterleavePcm(input, sample_format, getStaging(sample_size), 0, channel_count_, sample_size);
+  return push(reinterpret_cast<uintptr_t>(staging_buffer_), sample_size);
+}
+
+void RealtimeRubberBand::pullInterleaved(uintptr_t output_ptr, size_t sample_size, SampleFormat sample_format) {
+  auto *output = reinterpret_cast<void *>(output_ptr); // NOLINT(performance-no-int-to-ptr)
+  const float *const *staging = getStaging(sample_size);
+  pull(reinterpret_cast<uintptr_t>(staging_buffer_), sample_size);
+  interleavePcm(staging, 0, output, sample_format, channel_count_, sample_size);
+}
+
+float *const *RealtimeRubberBand::getStaging(size_t sample_size) {
+  if (sample_size > block_size_) {
+    throw std::range_error("Interleaved blocks must not exceed the block size");
+  }
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    staging_[channel] = staging_buffer_ + channel * sample_size;
+  }
+  return staging_;
+}
+
+bool RealtimeRubberBand::fetchProcessed() {
+  if (governor_.switching && start_delay_samples_ == 0) return drainEngineSwitch();
+  bool overflowed = false;
   while (true) {
     auto available = stretcher_->available();
-    if (available <= 0) return;
+    if (available <= 0) return true;
 
     // Discard start delay samples, but never retrieve more than our scratch buffer.
     if (start_delay_samples_ > 0) {
       const size_t discard = std::min<size_t>(
           std::min<size_t>(available, start_delay_samples_),
-          buffer_size_
+          block_size_
       );
       stretcher_->retrieve(scratch_, discard);
+      governor_.output_position += static_cast<double>(discard);
       start_delay_samples_ -= discard;
       continue;
     }
 
     const size_t write_space = output_buffer_[0]->getWriteSpace();
     if (write_space == 0) {
+      if (!overflowed) {
+        counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+        overflowed = true;
+      }
+      if (backpressure_) {
+        // Keep the output inside the stretcher, push() stops consuming input until pull() made room
+        return false;
+      }
       // Output ring buffer is full. If we stop retrieving, RubberBand will buffer internally
       // and can eventually enter a bad state (silence). Drain and drop output instead.
-      const size_t to_drop = std::min<size_t>(static_cast<size_t>(available), buffer_size_);
-      stretcher_->retrieve(scratch_, to_drop);
+      const size_t to_drop = std::min<size_t>(static_cast<size_t>(available), block_size_);
+      const size_t dropped = stretcher_->retrieve(scratch_, to_drop);
+      governor_.output_position += static_cast<double>(dropped);
+      counters_.dropped_frames.fetch_add(dropped, std::memory_order_relaxed);
       continue;
     }
 
     const size_t to_retrieve = std::min<size_t>(
         std::min<size_t>(available, write_space),
-        buffer_size_
+        block_size_
     );
-    if (to_retrieve == 0) return;
+    if (to_retrieve == 0) return true;
 
     const size_t actual = stretcher_->retrieve(scratch_, to_retrieve);
+    governor_.output_position += static_cast<double>(actual);
     for (size_t channel = 0; channel < channel_count_; ++channel) {
       output_buffer_[channel]->write(scratch_[channel], actual);
     }
   }
 }
 
+void RealtimeRubberBand::setBackpressure(bool enabled) {
+  backpressure_ = enabled;
+}
+
+uintptr_t RealtimeRubberBand::getCountersPtr() const {
+  return reinterpret_cast<uintptr_t>(&counters_);
+}
+
+size_t RealtimeRubberBand::getDroppedFrames() const {
+  return counters_.dropped_frames.load(std::memory_order_relaxed);
+}
+
+size_t RealtimeRubberBand::getUnderrunFrames() const {
+  return counters_.underrun_frames.load(std::memory_order_relaxed);
+}
+
+void RealtimeRubberBand::addUnderrunFrames(size_t frame_count) {
+  counters_.underrun_frames.fetch_add(frame_count, std::memory_order_relaxed);
+}
+
+size_t RealtimeRubberBand::getOverflowEvents() const {
+  return counters_.overflow_events.load(std::memory_order_relaxed);
+}
+
+size_t RealtimeRubberBand::getSkippedBlocks() const {
+  return counters_.skipped_blocks.load(std::memory_order_relaxed);
+}
+
+void RealtimeRubberBand::resetCounters() {
+  counters_.dropped_frames.store(0, std::memory_order_relaxed);
+  counters_.underrun_frames.store(0, std::memory_order_relaxed);
+  counters_.overflow_events.store(0, std::memory_order_relaxed);
+  counters_.skipped_blocks.store(0, std::memory_order_relaxed);
+}
+
+void RealtimeRubberBand::setSilenceGate(bool enabled, float threshold) {
+  if (threshold < 0) {
+    throw std::range_error("Silence threshold must not be negative");
+  }
+  silence_gate_ = enabled;
+  silence_threshold_ = threshold;
+  silent_frames_ = 0;
+  gated_output_ = 0;
+}
+
+bool RealtimeRubberBand::gateSilence(const float *const *input, size_t frame_count) {
+  if (!silence_gate_ || governor_.switching) return false;
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    const float *samples = input[channel];
+    for (size_t i = 0; i < frame_count; ++i) {
+      if (std::abs(samples[i]) > silence_threshold_) {
+        silent_frames_ = 0;
+        return false;
+      }
+    }
+  }
+  if (silent_frames_ == 0) {
+    silence_start_ = governor_.input_position;
+  }
+  silent_frames_ += frame_count;
+  if (!isGating()) return false;
+  counters_.skipped_blocks.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool RealtimeRubberBand::isGating() const {
+  // Keep feeding until the output got past the start of the silence by the stretcher's window, so the tail came
+  // out. The stretcher holds far more than its start delay at small time ratios, this waits for its output.
+  const double ratio = stretcher_->getTimeRatio();
+  return silence_gate_ && !governor_.switching && silent_frames_ > 0 &&
+      governor_.output_position >= silence_start_ + static_cast<double>(getGateDelay()) * ratio;
+}
+
+size_t RealtimeRubberBand::getGateDelay() const {
+  // The start pad is input, the start delay output
+  return stretcher_->getPreferredStartPad() +
+      static_cast<size_t>(std::ceil(static_cast<double>(stretcher_->getStartDelay()) / stretcher_->getTimeRatio()));
+}
+
+size_t RealtimeRubberBand::getGatedFrames(size_t input_frames) const {
+  // Output the stretcher would have produced, including the fraction left from the last block
+  return static_cast<size_t>(gated_output_ + static_cast<double>(input_frames) * stretcher_->getTimeRatio());
+}
+
+size_t RealtimeRubberBand::takeGatedFrames(size_t input_frames) {
+  const size_t frames = getGatedFrames(input_frames);
+  gated_output_ += static_cast<double>(input_frames) * stretcher_->getTimeRatio() - static_cast<double>(frames);
+  return frames;
+}
+
+void RealtimeRubberBand::writeSilence(size_t frame_count) {
+  size_t left = frame_count;
+  while (left > 0) {
+    const size_t chunk = std::min(left, block_size_);
+    const size_t written = output_ring_->write(silence_, chunk);
+    if (written < chunk) {
+      counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+      counters_.dropped_frames.fetch_add(left - written, std::memory_order_relaxed);
+      return;
+    }
+    left -= chunk;
+  }
+}
+
 // SAB-to-SAB support
+#ifdef __EMSCRIPTEN__
 void RealtimeRubberBand::setSABBuffers(emscripten::val input_audio, emscripten::val input_control, size_t input_ring_size,
                                         emscripten::val output_audio, emscripten::val output_control, size_t output_ring_size) {
-  input_audio_ = input_audio;
-  input_control_ = input_control;
-  input_ring_size_ = input_ring_size;
-  output_audio_ = output_audio;
-  output_control_ = output_control;
-  output_ring_size_ = output_ring_size;
-  sab_mode_ = true;
+  setRings(new ExternalAudioRing(input_audio, input_control, input_ring_size, channel_count_),
+           new ExternalAudioRing(output_audio, output_control, output_ring_size, channel_count_));
 }
+#endif
+
+void RealtimeRubberBand::createSharedBuffers(size_t input_ring_size, size_t output_ring_size) {
+  auto *input_ring = new SharedAudioRing(input_ring_size, channel_count_);
+  auto *output_ring = new SharedAudioRing(output_ring_size, channel_count_);
+  setRings(input_ring, output_ring);
+  shared_input_ring_ = input_ring;
+  shared_output_ring_ = output_ring;
+}
+
+uintptr_t RealtimeRubberBand::getInputAudioPtr() const {
+  return shared_input_ring_ ? shared_input_ring_->getAudioPtr() : 0;
+}
+
+uintptr_t RealtimeRubberBand::getInputControlPtr() const {
+  return shared_input_ring_ ? shared_input_ring_->getControlPtr() : 0;
+}
+
+uintptr_t RealtimeRubberBand::getOutputAudioPtr() const {
+  return shared_output_ring_ ? shared_output_ring_->getAudioPtr() : 0;
+}
+
+uintptr_t RealtimeRubberBand::getOutputControlPtr() const {
+  return shared_output_ring_ ? shared_output_ring_->getControlPtr() : 0;
+}
+
+AudioRing *RealtimeRubberBand::getInputRing() const {
+  return input_ring_;
+}
+
+AudioRing *RealtimeRubberBand::getOutputRing() const {
+  return output_ring_;
+}
+
+void RealtimeRubberBand::setRings(AudioRing *input_ring, AudioRing *output_ring) {
+  delete input_ring_;
+  delete output_ring_;
+  input_ring_ = input_ring;
+  output_ring_ = output_ring;
+  shared_input_ring_ = nullptr;
+  shared_output_ring_ = nullptr;
+}
+
+void RealtimeRubberBand::setCatchUp(bool enabled, size_t max_blocks) {
+  catch_up_ = enabled;
+  max_blocks_per_process_ = max_blocks;
+}
+
+size_t RealtimeRubberBand::process() {
+  DenormalGuard denormal_guard;
+  if (!telemetry_enabled_) return processBlocks();
+  const auto begin = std::chrono::steady_clock::now();
+  const size_t blocks = processBlocks();
+  recordTelemetry(begin, blocks * block_size_);
+  return blocks;
+}
+
+size_t RealtimeRubberBand::processBlocks() {
+  if (!input_ring_ || !output_ring_ || draining_) return 0;
+  const auto begin = governor_.enabled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  applyParameters();
 
-void RealtimeRubberBand::process() {
-  if (!sab_mode_) return;
-  
-  // Control buffer layout (matches FFmpeg SAB):
-  // 0=WRITE_PTR, 1=READ_PTR, 2=STATE, etc.
-  const int WRITE_PTR = 0;
-  const int READ_PTR = 1;
-  
-  // Use Atomics.load to read atomic values
-  emscripten::val atomics = emscripten::val::global("Atomics");
-  const int32_t input_write = atomics.call<int>("load", input_control_, WRITE_PTR);
-  int32_t input_read = atomics.call<int>("load", input_control_, READ_PTR);
-  
   // Calculate available input
-  int32_t input_available = input_write - input_read;
-  if (input_available < 0) input_available += input_ring_size_;
-  
+  const size_t input_available = input_ring_->getReadSpace();
+
   // Only process if we have enough for block_size
-  if (input_available < (int32_t)block_size_) return;
+  if (input_available < block_size_) return 0;
   
   // BYPASS MODE: If pitch=1.0 and tempo=1.0, directly copy without RubberBand processing
-  const double current_pitch = stretcher_->getPitchScale();
-  const double current_tempo = stretcher_->getTimeRatio();
+  if (isBypass()) {
+    const size_t copied = passThrough();
+    return (copied + block_size_ - 1) / block_size_;
+  }
   
+  // PROCESSING MODE: Use RubberBand for pitch/tempo adjustment
+
+  // Without catch-up we feed a single block per call, otherwise every full block within the budget
+  size_t max_blocks = input_available / block_size_;
+  if (!catch_up_) {
+    max_blocks = 1;
+  } else if (max_blocks_per_process_ > 0) {
+    max_blocks = std::min(max_blocks, max_blocks_per_process_);
+  }
+
+  size_t blocks = 0;
+  while (blocks < max_blocks) {
+    // Parameters posted in the meantime take effect at the block boundary
+    if (blocks > 0) applyParameters();
+
+    // CRITICAL: Always drain ALL available output first to prevent buffer overflow,
+    // unless backpressure asks us to leave the input where it is
+    if (!drainToOutputRing()) break;
+
+    // While gating, a silent block goes straight to the output: with backpressure leave it queued until the
+    // zeros fit (a block that turns out not to be silent waits as well)
+    if (backpressure_ && isGating() && output_ring_->getWriteSpace() < getGatedFrames(block_size_)) {
+      counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+      break;
+    }
+
+    // Now feed new input (RubberBand buffer is drained): de-interleave from input SAB to scratch
+    input_ring_->read(scratch_, block_size_);
+    if (gateSilence(scratch_, block_size_)) {
+      writeSilence(takeGatedFrames(block_size_));
+      ++blocks;
+      continue;
+    }
+
+    // Feed to RubberBand
+    stretcher_->process(scratch_, block_size_, false);
+    if (governor_.switching) {
+      standby_->process(scratch_, block_size_, false);
+    }
+    governor_.input_position += static_cast<double>(block_size_) * stretcher_->getTimeRatio();
+    ++blocks;
+  }
+
+  // When catching up, hand the result of the last block to the output ring right away
+  if (catch_up_) {
+    drainToOutputRing();
+  }
+  if (governor_.enabled && !governor_.switching) {
+    updateGovernor(begin, blocks * block_size_);
+  }
+  return blocks;
+}
+
+bool RealtimeRubberBand::isBypass() const {
   // Tolerance for floating point comparison
   const double bypass_tolerance = 0.001;
-  const bool is_bypass = (std::abs(current_pitch - 1.0) < bypass_tolerance) && 
-                          (std::abs(current_tempo - 1.0) < bypass_tolerance);
-  
-  if (is_bypass) {
-    // Direct passthrough - copy from input SAB to output SAB
-    const int32_t output_write = atomics.call<int>("load", output_control_, WRITE_PTR);
-    const int32_t output_read = atomics.call<int>("load", output_control_, READ_PTR);
-    int32_t output_space = output_read - output_write - 1;
-    if (output_space < 0) output_space += output_ring_size_;
-    
-    // Copy as much as we can fit
-    const int32_t to_copy = std::min(input_available, output_space);
-    if (to_copy <= 0) return;
-    
-    for (int32_t i = 0; i < to_copy; ++i) {
-      const size_t src_idx = ((input_read + i) % input_ring_size_) * 2;
-      const size_t dst_idx = ((output_write + i) % output_ring_size_) * 2;
-      for (size_t ch = 0; ch < channel_count_; ++ch) {
-        const float sample = input_audio_[src_idx + ch].as<float>();
-        output_audio_.set(dst_idx + ch, sample);
+  return (std::abs(stretcher_->getPitchScale() - 1.0) < bypass_tolerance) &&
+      (std::abs(stretcher_->getTimeRatio() - 1.0) < bypass_tolerance);
+}
+
+size_t RealtimeRubberBand::passThrough() {
+  // Direct passthrough - copy from input SAB to output SAB as much as we can fit
+  const size_t to_copy = std::min(input_ring_->getReadSpace(), output_ring_->getWriteSpace());
+  size_t left = to_copy;
+  while (left > 0) {
+    const size_t chunk = input_ring_->read(scratch_, std::min(left, block_size_));
+    output_ring_->write(scratch_, chunk);
+    left -= chunk;
+  }
+  return to_copy;
+}
+
+void RealtimeRubberBand::flush() {
+  stretcher_->reset();
+  resetPositions();
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    output_buffer_[channel]->reset();
+  }
+  // Queued SAB input is dropped, the output ring belongs to its JS consumer
+  if (input_ring_) {
+    input_ring_->skip(input_ring_->getReadSpace());
+  }
+}
+
+bool RealtimeRubberBand::drain() {
+  if (!draining_) {
+    applyParameters();
+    // The fade would need the standby stretcher's tail as well
+    cancelEngineSwitch();
+  }
+  if (input_ring_ && output_ring_) {
+    if (isBypass()) {
+      passThrough();
+      if (input_ring_->getReadSpace() > 0) return false;
+    } else {
+      // Whatever input is queued, the last (partial) block with the final flag
+      while (!draining_) {
+        if (!drainToOutputRing()) return false;
+        const size_t left = input_ring_->getReadSpace();
+        const size_t frames = input_ring_->read(scratch_, std::min(left, block_size_));
+        draining_ = frames == left;
+        stretcher_->process(scratch_, frames, draining_);
       }
+      if (!drainToOutputRing()) return false;
     }
-    
-    // Update pointers
-    atomics.call<void>("store", input_control_, READ_PTR, (input_read + to_copy) % input_ring_size_);
-    atomics.call<void>("store", output_control_, WRITE_PTR, (output_write + to_copy) % output_ring_size_);
-    return;
+  } else {
+    if (!draining_) {
+      stretcher_->process(silence_, 0, true);
+      draining_ = true;
+    }
+    if (!fetchProcessed()) return false;
   }
-  
-  // PROCESSING MODE: Use RubberBand for pitch/tempo adjustment
-  
-  // CRITICAL: Always drain ALL available output first to prevent buffer overflow
-  // Even if we can't write it all to output SAB, we must retrieve it from RubberBand
+  // Ready for the next stream, the tail stays queued for pull() or in the output ring
+  stretcher_->reset();
+  resetPositions();
+  return true;
+}
+
+size_t RealtimeRubberBand::getPrerollSize() const {
+  // The start pad, then enough input for the start delay and one more block of output, in whole blocks
+  const double output_frames = static_cast<double>(stretcher_->getStartDelay() + block_size_);
+  auto frames = static_cast<size_t>(std::ceil(output_frames / stretcher_->getTimeRatio())) +
+      start_pad_samples_;
+  if (stretcher_->getEngineVersion() != 3) {
+    frames = 2 * frames + kR2PrerollWindow;
+  }
+  return (frames + block_size_ - 1) / block_size_ * block_size_;
+}
+
+size_t RealtimeRubberBand::preroll(uintptr_t input_ptr, size_t sample_size) {
+  auto *input = reinterpret_cast<const float *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
+  applyParameters();
+  feedStartPad();
+  // A render quantum at a time, until one can be pulled
+  size_t offset = 0;
+  while (offset < sample_size && output_buffer_[0]->getReadSpace() < kRenderQuantum) {
+    const size_t frames = std::min(kRenderQuantum, sample_size - offset);
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      input_channels_[channel] = input + channel * sample_size + offset;
+    }
+    stretcher_->process(input_channels_, frames, false);
+    governor_.input_position += static_cast<double>(frames) * stretcher_->getTimeRatio();
+    fetchProcessed();
+    offset += frames;
+  }
+  return offset;
+}
+
+void RealtimeRubberBand::setGovernor(bool enabled, double high_load, double low_load) {
+  if (low_load <= 0 || high_load <= low_load) {
+    throw std::range_error("Governor loads have to satisfy 0 < low_load < high_load");
+  }
+  if (enabled && !standby_) {
+    if (!(options_ & RubberBand::RubberBandStretcher::OptionEngineFiner)) {
+      throw std::range_error("The governor needs the R3 engine");
+    }
+    // Same options on the faster engine, with its standard window
+    const RubberBand::RubberBandStretcher::Options standby_options =
+        (options_ & ~(RubberBand::RubberBandStretcher::OptionEngineFiner |
+            RubberBand::RubberBandStretcher::OptionWindowLong)) |
+            RubberBand::RubberBandStretcher::OptionEngineFaster;
+    standby_ = new RubberBand::RubberBandStretcher(sample_rate_, channel_count_, standby_options);
+    standby_->setMaxProcessSize(block_size_);
+    standby_scratch_ = new float *[channel_count_];
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      standby_scratch_[channel] = new float[block_size_];
+    }
+  }
+  governor_.enabled = enabled;
+  governor_.high_load = high_load;
+  governor_.low_load = low_load;
+  governor_.dwell_frames = 0;
+}
+
+size_t RealtimeRubberBand::getEngineSwitches() const {
+  return governor_.switches;
+}
+
+double RealtimeRubberBand::getGovernorLoad() const {
+  return governor_.load;
+}
+
+void RealtimeRubberBand::updateGovernor(std::chrono::steady_clock::time_point begin, size_t frames) {
+  if (frames == 0) return;
+  const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+  const double load = micros * static_cast<double>(sample_rate_) / (1e6 * static_cast<double>(frames));
+  governor_.load = governor_.dwell_frames == 0 ? load : governor_.load + (load - governor_.load) * kGovernorWeight;
+  governor_.dwell_frames += frames;
+  if (governor_.dwell_frames < sample_rate_) return;
+
+  const bool fallback = stretcher_->getEngineVersion() != 3;
+  if (fallback ? governor_.load < governor_.low_load : governor_.load > governor_.high_load) {
+    beginEngineSwitch();
+  }
+}
+
+void RealtimeRubberBand::beginEngineSwitch() {
+  standby_->reset();
+  standby_->setTimeRatio(stretcher_->getTimeRatio());
+  standby_->setPitchScale(stretcher_->getPitchScale());
+  standby_->setFormantScale(stretcher_->getFormantScale());
+
+  // The standby stretcher is padded and trimmed, so its first output belongs to the next input block.
+  // The active one still owes the output for everything before that: it plays alone for that long.
+  const double lag = governor_.input_position - governor_.output_position;
+  governor_.discard_frames = standby_->getStartDelay();
+  governor_.warmup_frames = 0;
+  if (lag > 0) {
+    governor_.warmup_frames = static_cast<size_t>(std::lround(lag));
+  } else {
+    governor_.discard_frames += static_cast<size_t>(std::lround(-lag));
+  }
+  size_t pad = standby_->getPreferredStartPad();
+  while (pad > 0) {
+    const size_t chunk = std::min(pad, block_size_);
+    standby_->process(silence_, chunk, false);
+    pad -= chunk;
+  }
+  governor_.fade_position = 0;
+  governor_.fade_frames = std::max<size_t>(sample_rate_ / kGovernorFadeDivisor, 1);
+  governor_.switching = true;
+}
+
+bool RealtimeRubberBand::drainEngineSwitch() {
+  bool overflowed = false;
+  while (true) {
+    while (governor_.discard_frames > 0 && standby_->available() > 0) {
+      const size_t discard = std::min(std::min<size_t>(standby_->available(), governor_.discard_frames), block_size_);
+      standby_->retrieve(standby_scratch_, discard);
+      governor_.discard_frames -= discard;
+    }
+
+    // Solo until the active stretcher reached the standby's first frame, then both in lockstep
+    const bool solo = governor_.warmup_frames > 0;
+    if (!solo && governor_.discard_frames > 0) return true;
+    size_t frames = std::min<size_t>(std::max(stretcher_->available(), 0), block_size_);
+    if (solo) {
+      frames = std::min(frames, governor_.warmup_frames);
+    } else {
+      frames = std::min<size_t>(frames, std::max(standby_->available(), 0));
+    }
+    if (frames == 0) return true;
+    if (backpressure_) {
+      const size_t write_space = getOutputWriteSpace();
+      if (write_space == 0) {
+        counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      frames = std::min(frames, write_space);
+    }
+
+    stretcher_->retrieve(scratch_, frames);
+    governor_.output_position += static_cast<double>(frames);
+    if (solo) {
+      governor_.warmup_frames -= frames;
+    } else {
+      // Linear crossfade, both engines play the same (correlated) material
+      standby_->retrieve(standby_scratch_, frames);
+      for (size_t i = 0; i < frames; ++i) {
+        const float gain = governor_.fade_position < governor_.fade_frames ?
+            static_cast<float>(++governor_.fade_position) / static_cast<float>(governor_.fade_frames) : 1.0f;
+        for (size_t channel = 0; channel < channel_count_; ++channel) {
+          scratch_[channel][i] += gain * (standby_scratch_[channel][i] - scratch_[channel][i]);
+        }
+      }
+    }
+
+    const size_t written = writeOutput(scratch_, frames);
+    if (written < frames) {
+      if (!overflowed) {
+        counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+        overflowed = true;
+      }
+      counters_.dropped_frames.fetch_add(frames - written, std::memory_order_relaxed);
+    }
+
+    if (!solo && governor_.fade_position >= governor_.fade_frames) {
+      // What is left in the old stretcher is dropped by the next reset()
+      std::swap(stretcher_, standby_);
+      governor_.switching = false;
+      governor_.dwell_frames = 0;
+      ++governor_.switches;
+      return output_ring_ ? drainToOutputRing() : fetchProcessed();
+    }
+  }
+}
+
+size_t RealtimeRubberBand::getOutputWriteSpace() const {
+  return output_ring_ ? output_ring_->getWriteSpace() : output_buffer_[0]->getWriteSpace();
+}
+
+size_t RealtimeRubberBand::writeOutput(const float *const *source, size_t frame_count) {
+  if (output_ring_) return output_ring_->write(source, frame_count);
+  size_t written = frame_count;
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    written = output_buffer_[channel]->write(source[channel], static_cast<int>(frame_count));
+  }
+  return written;
+}
+
+void RealtimeRubberBand::cancelEngineSwitch() {
+  if (!governor_.switching) return;
+  governor_.switching = false;
+  governor_.dwell_frames = 0;
+  standby_->reset();
+}
+
+void RealtimeRubberBand::setTelemetry(bool enabled) {
+  telemetry_enabled_ = enabled;
+}
+
+uintptr_t RealtimeRubberBand::getTelemetryPtr() const {
+  return reinterpret_cast<uintptr_t>(&telemetry_);
+}
+
+const RealtimeTelemetry &RealtimeRubberBand::getTelemetry() const {
+  return telemetry_;
+}
+
+void RealtimeRubberBand::resetTelemetry() {
+  telemetry_.reset();
+}
+
+void RealtimeRubberBand::recordTelemetry(std::chrono::steady_clock::time_point begin, size_t frames) {
+  telemetry_.beginUpdate();
+  // Calls without any work are not timed, but fill levels are always current
+  if (frames > 0) {
+    const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+    telemetry_.recordTiming(micros, 1e6 * static_cast<double>(frames) / static_cast<double>(sample_rate_));
+  }
+  if (output_ring_) {
+    telemetry_.recordFill(input_ring_->getReadSpace(), input_ring_->getFrameCount(),
+                          output_ring_->getReadSpace(), output_ring_->getFrameCount());
+  } else {
+    telemetry_.recordFill(0, 0, output_buffer_[0]->getReadSpace(), output_buffer_[0]->getSize());
+  }
+  telemetry_.recordCounters(counters_.underrun_frames.load(std::memory_order_relaxed),
+                            counters_.overflow_events.load(std::memory_order_relaxed),
+                            counters_.dropped_frames.load(std::memory_order_relaxed));
+  telemetry_.publish();
+}
+
+bool RealtimeRubberBand::drainToOutputRing() {
+  if (governor_.switching) return drainEngineSwitch();
+  bool overflowed = false;
   while (true) {
     auto available = stretcher_->available();
-    if (available <= 0) break;
+    if (available <= 0) return true;
     
     // Retrieve to scratch (drain internal buffer)
-    const size_t to_retrieve = std::min<size_t>(available, block_size_);
+    size_t to_retrieve = std::min<size_t>(available, block_size_);
+    if (backpressure_) {
+      // Only take what fits, the rest stays in the stretcher and no new input is consumed
+      const size_t write_space = output_ring_->getWriteSpace();
+      if (write_space == 0) {
+        counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      to_retrieve = std::min(to_retrieve, write_space);
+    }
     const size_t actual = stretcher_->retrieve(scratch_, to_retrieve);
-    if (actual == 0) break;
-    
-    // Try to write to output SAB (but continue even if buffer is full)
-    int32_t output_write = atomics.call<int>("load", output_control_, WRITE_PTR);
-    const int32_t output_read = atomics.call<int>("load", output_control_, READ_PTR);
-    int32_t output_space = output_read - output_write - 1;
-    if (output_space < 0) output_space += output_ring_size_;
+    if (actual == 0) return true;
+    governor_.output_position += static_cast<double>(actual);
     
-    const size_t can_write = std::min<size_t>(actual, static_cast<size_t>(output_space));
-    
-    if (can_write > 0) {
-      // Interleave to output SAB
-      for (size_t i = 0; i < can_write; ++i) {
-        size_t dst_idx = ((output_write + i) % output_ring_size_) * 2;
-        for (size_t ch = 0; ch < channel_count_; ++ch) {
-          output_audio_.set(dst_idx + ch, scratch_[ch][i]);
-        }
+    // Interleave to output SAB. Without backpressure we continue even if the buffer is full
+    // and discard the rest - prevents RubberBand buffer overflow
+    const size_t written = output_ring_->write(scratch_, actual);
+    if (written < actual) {
+      if (!overflowed) {
+        counters_.overflow_events.fetch_add(1, std::memory_order_relaxed);
+        overflowed = true;
       }
-      output_write = (output_write + can_write) % output_ring_size_;
-      atomics.call<void>("store", output_control_, WRITE_PTR, output_write);
+      counters_.dropped_frames.fetch_add(actual - written, std::memory_order_relaxed);
     }
-    // If can_write < actual, we're discarding (actual - can_write) samples
-    // This is OK - prevents RubberBand buffer overflow
   }
-  
-  // Now feed new input (RubberBand buffer is drained)
-  if (input_available < (int32_t)block_size_) return;
-  
-  // De-interleave from input SAB to scratch
-  for (size_t i = 0; i < block_size_; ++i) {
-    size_t src_idx = ((input_read + i) % input_ring_size_) * 2;
-    for (size_t ch = 0; ch < channel_count_; ++ch) {
-      scratch_[ch][i] = input_audio_[src_idx + ch].as<float>();
-    }
+}
+
+void RealtimeRubberBand::feedStartPad() {
+  // A block of silence at a time
+  while (start_pad_samples_ > 0) {
+    const size_t pad = std::min(start_pad_samples_, block_size_);
+    stretcher_->process(silence_, pad, false);
+    governor_.input_position += static_cast<double>(pad) * stretcher_->getTimeRatio();
+    start_pad_samples_ -= pad;
+    fetchProcessed();
   }
-  
-  // Update input read pointer
-  input_read = (input_read + block_size_) % input_ring_size_;
-  atomics.call<void>("store", input_control_, READ_PTR, input_read);
-  
-  // Feed to RubberBand
-  stretcher_->process(scratch_, block_size_, false);
+}
+
+void RealtimeRubberBand::resetPositions() {
+  cancelEngineSwitch();
+  draining_ = false;
+  // process() feeds no start pad, so the first output frames belong to input before the start. push() feeds the
+  // pad and drops the start delay, both counted, which ends up aligned the same way.
+  governor_.input_position = 0;
+  governor_.output_position = static_cast<double>(stretcher_->getPreferredStartPad()) * stretcher_->getTimeRatio() -
+      static_cast<double>(stretcher_->getStartDelay());
+  // The gate counts silence in these positions, a new stream starts it over
+  silent_frames_ = 0;
+  silence_start_ = 0;
+  gated_output_ = 0;
+  updateRatio();
 }
 
 void RealtimeRubberBand::updateRatio() {
@@ -5,62 +5,352 @@
 #ifndef RUBBERBAND_WEB_SRC_REALTIME_RUBBERBAND_H_
 #define RUBBERBAND_WEB_SRC_REALTIME_RUBBERBAND_H_
 
+#include <atomic>
+#include <chrono>
 #include <RubberBandStretcher.h>
+#ifdef __EMSCRIPTEN__
 #include <emscripten/val.h>
+#endif
 #include "../../lib/third-party/rubberband-3.0.0/src/common/RingBuffer.h"
+#include "AudioRing.h"
+#include "ParameterMailbox.h"
+#include "PcmConversion.h"
+#include "RealtimeTelemetry.h"
+#include "SharedAudioRing.h"
 
 class RealtimeRubberBand {
  public:
-  RealtimeRubberBand(size_t sampleRate, size_t channel_count, bool high_quality = false, bool formant_preserved = false, int transients = 0, int detector = 0, size_t block_size = 512);
+  // Profiles: kProfileDefault uses the R3 engine, kProfileLowLatency is meant for live monitoring
+  // (R2 engine with short windows, block size capped at one render quantum)
+  static const int kProfileDefault = 0;
+  static const int kProfileLowLatency = 1;
+
+  RealtimeRubberBand(size_t sampleRate, size_t channel_count, bool high_quality = false, bool formant_preserved = false, int transients = 0, int detector = 0, size_t block_size = 512, int profile = kProfileDefault);
   ~RealtimeRubberBand();
 
+  // Engine currently in use (3 = R3/finer, 2 = R2/faster), changes when the governor switches
   int getVersion();
 
+  // Parameter changes are queued and applied by the audio thread at the next block boundary
   void setTempo(double tempo);
 
-  void setPitch(double tempo);
+  void setPitch(double pitch);
 
   void setFormantScale(double scale);
 
+  // The pull() output ring holds one block plus the headroom (250 ms by default) at the largest time ratio
+  // seen so far. setTempo() grows it when needed, setMaxTimeRatio() reserves up front. The ring is
+  // allocated on the calling thread and swapped in at the next block boundary, it never shrinks.
+  void setMaxTimeRatio(double ratio);
+
+  void setOutputHeadroom(double milliseconds);
+
+  // Frames the output ring is (about to be) sized for
+  [[nodiscard]] size_t getOutputCapacity() const;
+
+  // Bytes held by this instance's own buffers and rings, without the stretcher's internal state
+  [[nodiscard]] size_t getMemoryUsage() const;
+
+  // Latency components in frames: queued SAB input, one block, the stretcher start delay and queued output
+  [[nodiscard]] size_t getInputLatency() const;
+
+  [[nodiscard]] size_t getBlockLatency() const;
+
+  [[nodiscard]] size_t getStretcherLatency() const;
+
+  [[nodiscard]] size_t getOutputLatency() const;
+
+  // Sum of all components above
+  [[nodiscard]] size_t getLatency() const;
+
+  // Latest values set, the stretcher picks them up at the next block boundary
+  [[nodiscard]] double getTempo() const;
+
+  [[nodiscard]] double getPitch() const;
+
+  [[nodiscard]] double getFormantScale() const;
+
   __attribute__((unused)) size_t getSamplesAvailable();
 
-  void push(uintptr_t input_ptr, size_t sample_size);
+  // Returns false (and leaves the input alone) when backpressure is enabled and output is waiting for pull()
+  bool push(uintptr_t input_ptr, size_t sample_size);
 
   __attribute__((unused)) void pull(uintptr_t output_ptr, size_t sample_size);
+
+  // push()/pull() on interleaved samples, converted on the way through a preallocated planar block.
+  // Throws std::range_error for more than block_size frames.
+  bool pushInterleaved(uintptr_t input_ptr, size_t sample_size, SampleFormat sample_format);
+
+  void pullInterleaved(uintptr_t output_ptr, size_t sample_size, SampleFormat sample_format);
   
+#ifdef __EMSCRIPTEN__
   // SAB-to-SAB processing (uses emscripten::val for external JS memory)
   void setSABBuffers(emscripten::val input_audio, emscripten::val input_control, size_t input_ring_size,
                      emscripten::val output_audio, emscripten::val output_control, size_t output_ring_size);
-  void process();
+#endif
+
+  // Zero-copy SAB processing: rings and control words are allocated inside the WASM memory,
+  // JS attaches Float32Array/Int32Array views using the pointers below
+  void createSharedBuffers(size_t input_ring_size, size_t output_ring_size);
+
+  [[nodiscard]] uintptr_t getInputAudioPtr() const;
+
+  [[nodiscard]] uintptr_t getInputControlPtr() const;
+
+  [[nodiscard]] uintptr_t getOutputAudioPtr() const;
+
+  [[nodiscard]] uintptr_t getOutputControlPtr() const;
+
+  // Rings in use, nullptr until setSABBuffers()/createSharedBuffers() was called
+  [[nodiscard]] AudioRing *getInputRing() const;
+
+  [[nodiscard]] AudioRing *getOutputRing() const;
+
+  // Returns the number of blocks processed (or passed through in bypass mode)
+  size_t process();
+
+  // Seek support: resets the stretcher and drops queued input and pull() output, keeping all allocations.
+  // The JS consumer of a SAB output ring drops its queued output itself (READ_PTR = WRITE_PTR).
+  void flush();
+
+  // End of stream: processes the queued SAB input (or nothing, for push()) as the final block and hands the
+  // tail to the output, then resets the stretcher so the next stream can follow gaplessly and returns true.
+  // With backpressure it returns false as soon as the output is full, keeping the rest of the tail: pull() and
+  // call drain() again. push()/process() take no input until it returned true. Without backpressure output
+  // that does not fit is dropped and counted.
+  bool drain();
+
+  // After flush(), primes the stretcher with push()-style planar input from the seek position until a render
+  // quantum (128 frames) can be pulled, returns the frames consumed; push() continues after those.
+  // getPrerollSize() is an upper bound for the input needed. SAB users write the pre-roll into the input
+  // ring and process() it with catch-up enabled.
+  size_t preroll(uintptr_t input_ptr, size_t sample_size);
+
+  [[nodiscard]] size_t getPrerollSize() const;
+
+  // Catch-up mode: process() consumes every full block available, up to max_blocks per call (0 = no limit)
+  void setCatchUp(bool enabled, size_t max_blocks);
+
+  // Backpressure: when the output is full, stop consuming input instead of dropping processed output
+  void setBackpressure(bool enabled);
+
+  // Counters live inside the WASM memory: JS can read them through a Uint32Array of kCounterCount
+  // entries at getCountersPtr() (0=dropped frames, 1=underrun frames, 2=overflow events, 3=blocks skipped
+  // by the silence gate). They wrap at 2^32.
+  // Underruns of the SAB output ring happen on the JS side, which may add them with Atomics.add.
+  [[nodiscard]] uintptr_t getCountersPtr() const;
+
+  [[nodiscard]] size_t getDroppedFrames() const;
+
+  [[nodiscard]] size_t getUnderrunFrames() const;
+
+  // For a C++ reader of the SAB output ring that had to fill frame_count frames with silence
+  void addUnderrunFrames(size_t frame_count);
+
+  [[nodiscard]] size_t getOverflowEvents() const;
+
+  [[nodiscard]] size_t getSkippedBlocks() const;
+
+  void resetCounters();
+
+  static const size_t kCounterCount = 4;
+
+  // Silence gate: once the input stayed below threshold (default -100 dBFS) for longer than the stretcher
+  // latency, blocks bypass the stretcher and the matching amount of zeros is output. Processing resumes with
+  // the first block above the threshold. Native builds also flush denormals to zero in push()/process().
+  void setSilenceGate(bool enabled, float threshold = 1e-5f);
+
+  // Telemetry: when enabled, push()/process() time themselves and publish load, fill levels and xrun
+  // counts into a block of RealtimeTelemetry::kWordCount 32 bit words at getTelemetryPtr()
+  void setTelemetry(bool enabled);
+
+  [[nodiscard]] uintptr_t getTelemetryPtr() const;
+
+  [[nodiscard]] const RealtimeTelemetry &getTelemetry() const;
+
+  void resetTelemetry();
+
+  // Engine governor: push()/process() measure their load (processing time / audio time) and falls back to the
+  // R2 engine when the average exceeds high_load, returning to R3 once it stays below low_load. Each switch
+  // needs a second of audio on the current engine and crossfades both engines over a few milliseconds.
+  // Since R2 is about three times cheaper, low_load should be well below high_load / 3.
+  // Allocates the standby stretcher, so call it before processing starts.
+  void setGovernor(bool enabled, double high_load = 0.8, double low_load = 0.2);
+
+  [[nodiscard]] size_t getEngineSwitches() const;
+
+  // Load average the governor decides on
+  [[nodiscard]] double getGovernorLoad() const;
   
  private:
   void updateRatio();
 
-  void fetchProcessed();
+  // Applies the latest queued parameters, reconfiguring the stretcher at most once
+  void applyParameters();
+
+  bool pushInput(uintptr_t input_ptr, size_t sample_size);
+
+  // Channel pointers into the staging block for sample_size frames, laid out like push() input
+  float *const *getStaging(size_t sample_size);
+
+  void feedStartPad();
+
+  // Start pad/delay and governor positions for a fresh (or reset) stretcher
+  void resetPositions();
+
+  [[nodiscard]] bool isBypass() const;
+
+  // Copies as much SAB input to the SAB output as fits, returns the frame count
+  size_t passThrough();
+
+  // Silence gate: true when the block can skip the stretcher
+  bool gateSilence(const float *const *input, size_t frame_count);
+
+  // True while silent input skips the stretcher
+  [[nodiscard]] bool isGating() const;
+
+  // Input frames of silence the stretcher has to output after the last sound before it can be skipped
+  [[nodiscard]] size_t getGateDelay() const;
+
+  // Output frames for input_frames of skipped input at the current time ratio
+  [[nodiscard]] size_t getGatedFrames(size_t input_frames) const;
+
+  // Same, and carries the fraction over to the next block
+  size_t takeGatedFrames(size_t input_frames);
+
+  // Zeros into the SAB output ring
+  void writeSilence(size_t frame_count);
+
+  [[nodiscard]] size_t getOutputFrames(double ratio) const;
+
+  [[nodiscard]] RubberBand::RingBuffer<float> **createOutputBuffer(size_t frame_count) const;
+
+  void deleteOutputBuffer(RubberBand::RingBuffer<float> **buffer) const;
+
+  // Caller thread: prepares a larger output ring if ratio needs one
+  void reserveOutput(double ratio);
+
+  // Audio thread: takes over a prepared output ring
+  void swapOutputBuffer();
+
+  size_t processBlocks();
 
+  void recordTelemetry(std::chrono::steady_clock::time_point begin, size_t frames);
+
+  // Both return false when backpressure left output inside the stretcher
+  bool fetchProcessed();
+
+  // Moves everything the stretcher has available into the output ring
+  bool drainToOutputRing();
+
+  // Governor: measures a processing call and starts a switch when needed
+  void updateGovernor(std::chrono::steady_clock::time_point begin, size_t frames);
+
+  // Primes the standby stretcher, aligned to the output of the active one
+  void beginEngineSwitch();
+
+  // Crossfades active and standby output into the output, swaps them once the fade is done
+  bool drainEngineSwitch();
+
+  // Output of either path: the SAB output ring, or the pull() ring buffers
+  [[nodiscard]] size_t getOutputWriteSpace() const;
+
+  size_t writeOutput(const float *const *source, size_t frame_count);
+
+  // Stops a switch half way, the active stretcher has all the input and carries on alone
+  void cancelEngineSwitch();
+
+  struct Counters {
+    std::atomic<uint32_t> dropped_frames{0};
+    std::atomic<uint32_t> underrun_frames{0};
+    std::atomic<uint32_t> overflow_events{0};
+    std::atomic<uint32_t> skipped_blocks{0};
+  };
+
+  struct Governor {
+    bool enabled = false;
+    double high_load = 0.8;
+    double low_load = 0.2;
+    double load = 0;
+    // Audio frames processed since the last switch
+    size_t dwell_frames = 0;
+    size_t switches = 0;
+    // Positions of the active stretcher in output frames: input fed so far and the input position of its
+    // next output frame, their difference is what the standby stretcher has to be delayed by. The silence gate
+    // uses them to tell when the tail came out.
+    double input_position = 0;
+    double output_position = 0;
+    bool switching = false;
+    size_t discard_frames = 0;
+    size_t warmup_frames = 0;
+    size_t fade_position = 0;
+    size_t fade_frames = 0;
+  };
+
+  RubberBand::RubberBandStretcher::Options options_;
   RubberBand::RubberBandStretcher *stretcher_;
+  // Stretcher with the other engine, only created by setGovernor()
+  RubberBand::RubberBandStretcher *standby_ = nullptr;
+  float **standby_scratch_ = nullptr;
+  Governor governor_;
   RubberBand::RingBuffer<float> **output_buffer_;
+  std::atomic<RubberBand::RingBuffer<float> **> pending_output_buffer_{nullptr};
+  std::atomic<RubberBand::RingBuffer<float> **> retired_output_buffer_{nullptr};
+  // Caller side of the output sizing
+  double max_time_ratio_ = 1.0;
+  double headroom_millis_ = 0;
+  size_t reserved_frames_ = 0;
+
+  ParameterMailbox parameters_;
 
   size_t start_pad_samples_;
 
   size_t start_delay_samples_;
 
+  size_t sample_rate_;
+
   size_t channel_count_;
   float **scratch_;
 
-  size_t buffer_size_ = 0;
+  // Channel pointers handed to the stretcher by push()
+  const float **input_channels_;
+
+  // Planar block for pushInterleaved()/pullInterleaved()
+  float *staging_buffer_;
+  float **staging_;
+
+  // One block of zeros shared by all channels, used for the start pad
+  float *silence_buffer_;
+  const float **silence_;
 
   size_t block_size_ = 512;
   const size_t kReserve_ = 8192;
   
-  // SAB support (JavaScript TypedArrays)
-  emscripten::val input_audio_;
-  emscripten::val input_control_;
-  size_t input_ring_size_;
-  emscripten::val output_audio_;
-  emscripten::val output_control_;
-  size_t output_ring_size_;
-  bool sab_mode_;
+  void setRings(AudioRing *input_ring, AudioRing *output_ring);
+
+  // SAB support, either JavaScript TypedArrays or shared rings inside the WASM memory
+  AudioRing *input_ring_ = nullptr;
+  AudioRing *output_ring_ = nullptr;
+  SharedAudioRing *shared_input_ring_ = nullptr;
+  SharedAudioRing *shared_output_ring_ = nullptr;
+
+  bool backpressure_ = false;
+  Counters counters_;
+  // drain() fed the final block and still holds tail output
+  bool draining_ = false;
+
+  bool telemetry_enabled_ = false;
+  RealtimeTelemetry telemetry_;
+
+  bool silence_gate_ = false;
+  float silence_threshold_ = 1e-5f;
+  size_t silent_frames_ = 0;
+  // Input position of the first silent frame, in output frames like the governor positions
+  double silence_start_ = 0;
+  double gated_output_ = 0;
+
+  bool catch_up_ = false;
+  size_t max_blocks_per_process_ = 0;
 };
 
 #endif //RUBBERBAND_WEB_SRC_REALTIME_RUBBERBAND_H_
@@ -0,0 +1,120 @@
+//
+// Makes sure the audio thread entry points of RealtimeRubberBand never touch the heap.
+//
+// The global allocator is replaced for the whole test binary, but only counts while a guard is active.
+//
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include "RealtimeRubberBand.h"
+
+static std::atomic<bool> guard_active{false};
+static std::atomic<size_t> guarded_allocations{0};
+
+static void *countedAllocate(std::size_t size) {
+  if (guard_active.load(std::memory_order_relaxed)) {
+    guarded_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  void *ptr = std::malloc(size > 0 ? size : 1);
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new(std::size_t size) { return countedAllocate(size); }
+void *operator new[](std::size_t size) { return countedAllocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return std::malloc(size > 0 ? size : 1); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return std::malloc(size > 0 ? size : 1); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+// Counts heap allocations made by everything within its scope
+class AllocationGuard {
+ public:
+  AllocationGuard() {
+    guarded_allocations = 0;
+    guard_active = true;
+  }
+  ~AllocationGuard() {
+    guard_active = false;
+  }
+  static size_t count() {
+    return guarded_allocations.load();
+  }
+};
+
+TEST(RealtimeRubberBandAllocation, PushPullDoNotAllocate) {
+  const size_t channel_count = 2;
+  const size_t block_size = 128;
+  RealtimeRubberBand rubber_band(48000, channel_count, false, false, 0, 0, block_size);
+  rubber_band.setPitch(1.3);
+
+  std::vector<float> input(channel_count * block_size, 0.25f);
+  std::vector<float> output(channel_count * block_size);
+  const auto input_ptr = reinterpret_cast<uintptr_t>(input.data());
+  const auto output_ptr = reinterpret_cast<uintptr_t>(output.data());
+
+  // The first push() also feeds the start pad; fetchProcessed() runs inside push()
+  size_t allocations;
+  {
+    AllocationGuard guard;
+    for (int i = 0; i < 200; ++i) {
+      rubber_band.push(input_ptr, block_size);
+      rubber_band.pull(output_ptr, block_size);
+    }
+    allocations = AllocationGuard::count();
+  }
+  EXPECT_EQ(allocations, 0);
+
+  // Queued parameter changes are applied by the next push(), which must not allocate either
+  rubber_band.setPitch(0.8);
+  rubber_band.setTempo(1.2);
+  {
+    AllocationGuard guard;
+    for (int i = 0; i < 200; ++i) {
+      rubber_band.push(input_ptr, block_size);
+      rubber_band.pull(output_ptr, block_size);
+    }
+    allocations = AllocationGuard::count();
+  }
+  EXPECT_EQ(allocations, 0);
+
+  // Interleaved int16 converts through the preallocated staging block
+  std::vector<int16_t> pcm(channel_count * block_size, 8192);
+  const auto pcm_ptr = reinterpret_cast<uintptr_t>(pcm.data());
+  {
+    AllocationGuard guard;
+    for (int i = 0; i < 200; ++i) {
+      rubber_band.pushInterleaved(pcm_ptr, block_size, SampleFormat::kInt16);
+      rubber_band.pullInterleaved(pcm_ptr, block_size, SampleFormat::kInt16);
+    }
+    allocations = AllocationGuard::count();
+  }
+  EXPECT_EQ(allocations, 0);
+}
+
+TEST(RealtimeRubberBandAllocation, ProcessDoesNotAllocate) {
+  const size_t block_size = 128;
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+  rubber_band.createSharedBuffers(4096, 16384);
+  rubber_band.setCatchUp(true, 0);
+  auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getInputControlPtr());
+  auto *output_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getOutputControlPtr());
+
+  size_t allocations;
+  for (double pitch : {1.0, 1.5}) {
+    rubber_band.setPitch(pitch);
+    AllocationGuard guard;
+    for (int i = 0; i < 200; ++i) {
+      // Producer queues a block, consumer takes whatever is there
+      input_control[AudioRing::kWritePtr].store(static_cast<int32_t>((i + 1) * block_size % 4096));
+      rubber_band.process();
+      output_control[AudioRing::kReadPtr].store(output_control[AudioRing::kWritePtr].load());
+    }
+    allocations = AllocationGuard::count();
+    EXPECT_EQ(allocations, 0) << "pitch " << pitch;
+  }
+}
@@ -0,0 +1,141 @@
+//
+// Owns several RealtimeRubberBand tracks and advances all of them with a single process() call,
+// optionally mixing their output into one shared output bus.
+//
+
+#include "RealtimeRubberBandHost.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+RealtimeRubberBandHost::RealtimeRubberBandHost(size_t sample_rate, size_t channel_count, size_t block_size) :
+    sample_rate_(sample_rate),
+    channel_count_(channel_count),
+    block_size_(block_size > 0 ? block_size : 512) {
+  if (sample_rate <= 0) {
+    throw std::range_error("Sample rate has to be greater than 0");
+  }
+  if (channel_count <= 0) {
+    throw std::range_error("Channel count has to be greater than 0");
+  }
+  mix_buffer_ = new float *[channel_count_];
+  track_buffer_ = new float *[channel_count_];
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    mix_buffer_[channel] = new float[block_size_];
+    track_buffer_[channel] = new float[block_size_];
+  }
+}
+
+RealtimeRubberBandHost::~RealtimeRubberBandHost() {
+  for (auto &track : tracks_) {
+    delete track.stretcher;
+  }
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    delete[] mix_buffer_[channel];
+    delete[] track_buffer_[channel];
+  }
+  delete[] mix_buffer_;
+  delete[] track_buffer_;
+  delete mix_ring_;
+}
+
+size_t RealtimeRubberBandHost::addTrack(bool high_quality, bool formant_preserved, int transients, int detector,
+                                        size_t input_ring_size, size_t output_ring_size) {
+  auto *stretcher = new RealtimeRubberBand(sample_rate_, channel_count_, high_quality, formant_preserved,
+                                           transients, detector, block_size_);
+  stretcher->createSharedBuffers(input_ring_size, output_ring_size);
+  tracks_.push_back({stretcher, 1.0f, true, false});
+  return tracks_.size() - 1;
+}
+
+size_t RealtimeRubberBandHost::getTrackCount() const {
+  return tracks_.size();
+}
+
+RealtimeRubberBand *RealtimeRubberBandHost::getTrack(size_t track) const {
+  return tracks_.at(track).stretcher;
+}
+
+void RealtimeRubberBandHost::setTrackGain(size_t track, float gain) {
+  tracks_.at(track).gain = gain;
+}
+
+void RealtimeRubberBandHost::setTrackActive(size_t track, bool active) {
+  tracks_.at(track).active = active;
+}
+
+void RealtimeRubberBandHost::createMixBus(size_t ring_size) {
+  delete mix_ring_;
+  mix_ring_ = new SharedAudioRing(ring_size, channel_count_);
+}
+
+uintptr_t RealtimeRubberBandHost::getMixAudioPtr() const {
+  return mix_ring_ ? mix_ring_->getAudioPtr() : 0;
+}
+
+uintptr_t RealtimeRubberBandHost::getMixControlPtr() const {
+  return mix_ring_ ? mix_ring_->getControlPtr() : 0;
+}
+
+size_t RealtimeRubberBandHost::process() {
+  size_t blocks = 0;
+  for (auto &track : tracks_) {
+    const size_t track_blocks = track.stretcher->process();
+    track.starved = track_blocks == 0 && track.stretcher->getInputRing()->getReadSpace() < block_size_;
+    blocks += track_blocks;
+  }
+  if (mix_ring_) {
+    mix();
+  }
+  return blocks;
+}
+
+void RealtimeRubberBandHost::mix() {
+  for (const auto &track : tracks_) {
+    if (!track.active) {
+      AudioRing *output = track.stretcher->getOutputRing();
+      output->skip(output->getReadSpace());
+    }
+  }
+  while (true) {
+    // Wait for the tracks that are still fed; when none is, hand out what is left
+    size_t frames = std::min(block_size_, mix_ring_->getWriteSpace());
+    size_t left = 0;
+    bool any_active = false;
+    bool any_fed = false;
+    for (const auto &track : tracks_) {
+      if (!track.active) continue;
+      const size_t available = track.stretcher->getOutputRing()->getReadSpace();
+      if (track.starved) {
+        left = std::max(left, available);
+      } else {
+        frames = std::min(frames, available);
+        any_fed = true;
+      }
+      any_active = true;
+    }
+    if (!any_fed) {
+      frames = std::min(frames, left);
+    }
+    if (!any_active || frames == 0) return;
+
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      std::fill(mix_buffer_[channel], mix_buffer_[channel] + frames, 0.0f);
+    }
+    for (const auto &track : tracks_) {
+      if (!track.active) continue;
+      const size_t read = track.stretcher->getOutputRing()->read(track_buffer_, frames);
+      if (read < frames) {
+        track.stretcher->addUnderrunFrames(frames - read);
+      }
+      for (size_t channel = 0; channel < channel_count_; ++channel) {
+        float *destination = mix_buffer_[channel];
+        const float *source = track_buffer_[channel];
+        for (size_t i = 0; i < read; ++i) {
+          destination[i] += source[i] * track.gain;
+        }
+      }
+    }
+    mix_ring_->write(mix_buffer_, frames);
+  }
+}
@@ -0,0 +1,68 @@
+//
+// Owns several RealtimeRubberBand tracks and advances all of them with a single process() call,
+// optionally mixing their output into one shared output bus.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_REALTIMERUBBERBANDHOST_H_
+#define WASM_SRC_RUBBERBAND_REALTIMERUBBERBANDHOST_H_
+
+#include <vector>
+#include "RealtimeRubberBand.h"
+#include "SharedAudioRing.h"
+
+class RealtimeRubberBandHost {
+ public:
+  RealtimeRubberBandHost(size_t sample_rate, size_t channel_count, size_t block_size = 512);
+  ~RealtimeRubberBandHost();
+
+  // Adds a track with its own shared input/output rings (see RealtimeRubberBand::createSharedBuffers),
+  // returns its index
+  size_t addTrack(bool high_quality, bool formant_preserved, int transients, int detector,
+                  size_t input_ring_size, size_t output_ring_size);
+
+  [[nodiscard]] size_t getTrackCount() const;
+
+  // The host keeps ownership, use it for parameters and ring pointers but never delete it
+  [[nodiscard]] RealtimeRubberBand *getTrack(size_t track) const;
+
+  void setTrackGain(size_t track, float gain);
+
+  // Inactive tracks are still processed, but neither hold back nor contribute to the mix bus: their output is
+  // discarded, so they come back in step with the others
+  void setTrackActive(size_t track, bool active);
+
+  // Mix bus: output of all active tracks is summed into this ring instead of being read per track. A track
+  // that had less than a block of input for process() does not hold the others back, what it is missing is
+  // mixed as silence and counted as underrun frames of that track.
+  void createMixBus(size_t ring_size);
+
+  [[nodiscard]] uintptr_t getMixAudioPtr() const;
+
+  [[nodiscard]] uintptr_t getMixControlPtr() const;
+
+  // Processes every track, then mixes; returns the number of blocks processed over all tracks
+  size_t process();
+
+ private:
+  struct Track {
+    RealtimeRubberBand *stretcher;
+    float gain;
+    bool active;
+    // Its input ran dry in the last process() call
+    bool starved;
+  };
+
+  // Sums what all active tracks have in common into the mix bus, a block at a time
+  void mix();
+
+  size_t sample_rate_;
+  size_t channel_count_;
+  size_t block_size_;
+  std::vector<Track> tracks_;
+
+  SharedAudioRing *mix_ring_ = nullptr;
+  float **mix_buffer_;
+  float **track_buffer_;
+};
+
+#endif //WASM_SRC_RUBBERBAND_REALTIMERUBBERBANDHOST_H_
@@ -2,7 +2,11 @@
 // Created by Tobias Hegemann on 22.09.22.
 //
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include "RealtimeRubberBand.h"
+#include "RealtimeRubberBandHost.h"
 
 TEST(RubberbandAPI, RealtimeRubberband) {
   // Test constructor parameters
@@ -35,3 +39,834 @@ TEST(RubberbandAPI, RealtimeRubberband) {
                      rubber_band->setTempo(-1);
                    });
 }
+
+TEST(RubberbandAPI, SharedAudioRing) {
+  EXPECT_ANY_THROW({
+                     SharedAudioRing(1, 2);
+                   });
+
+  SharedAudioRing ring(8, 2);
+  EXPECT_EQ(ring.getReadSpace(), 0);
+  EXPECT_EQ(ring.getWriteSpace(), 7);
+
+  float left[6], right[6];
+  float *channels[] = {left, right};
+  // Move the pointers close to the end, so the next write wraps around
+  for (size_t i = 0; i < 6; ++i) {
+    left[i] = 0;
+    right[i] = 0;
+  }
+  EXPECT_EQ(ring.write(channels, 6), 6);
+  EXPECT_EQ(ring.read(channels, 6), 6);
+
+  for (size_t i = 0; i < 6; ++i) {
+    left[i] = static_cast<float>(i);
+    right[i] = -static_cast<float>(i);
+  }
+  EXPECT_EQ(ring.write(channels, 6), 6);
+  EXPECT_EQ(ring.getReadSpace(), 6);
+  EXPECT_EQ(ring.getWriteSpace(), 1);
+
+  // Interleaved layout as seen by JS
+  auto *audio = reinterpret_cast<const float *>(ring.getAudioPtr());
+  EXPECT_EQ(audio[6 * 2], 0.0f);
+  EXPECT_EQ(audio[7 * 2 + 1], -1.0f);
+  EXPECT_EQ(audio[0], 2.0f);
+
+  float out_left[6], out_right[6];
+  float *out[] = {out_left, out_right};
+  EXPECT_EQ(ring.read(out, 10), 6);
+  for (size_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(out_left[i], static_cast<float>(i));
+    EXPECT_EQ(out_right[i], -static_cast<float>(i));
+  }
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandSharedBuffers) {
+  const size_t block_size = 128;
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+  EXPECT_EQ(rubber_band.getInputAudioPtr(), 0);
+
+  rubber_band.createSharedBuffers(1024, 1024);
+  auto *input_audio = reinterpret_cast<float *>(rubber_band.getInputAudioPtr());
+  auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getInputControlPtr());
+  auto *output_audio = reinterpret_cast<float *>(rubber_band.getOutputAudioPtr());
+  auto *output_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getOutputControlPtr());
+  ASSERT_NE(input_audio, nullptr);
+  ASSERT_NE(output_control, nullptr);
+
+  // Not enough input for a block yet
+  input_control[AudioRing::kWritePtr].store(block_size - 1);
+  rubber_band.process();
+  EXPECT_EQ(output_control[AudioRing::kWritePtr].load(), 0);
+
+  // Act like the JS producer: write interleaved frames and publish the write pointer
+  for (size_t i = 0; i < 2 * block_size; ++i) {
+    input_audio[i * 2] = static_cast<float>(i) / 1000.0f;
+    input_audio[i * 2 + 1] = -static_cast<float>(i) / 1000.0f;
+  }
+  input_control[AudioRing::kWritePtr].store(2 * block_size);
+
+  // Pitch and tempo are neutral, so the input is passed through untouched
+  rubber_band.process();
+  EXPECT_EQ(input_control[AudioRing::kReadPtr].load(), 2 * block_size);
+  EXPECT_EQ(output_control[AudioRing::kWritePtr].load(), 2 * block_size);
+  for (size_t i = 0; i < 2 * block_size; ++i) {
+    EXPECT_EQ(output_audio[i * 2], input_audio[i * 2]);
+    EXPECT_EQ(output_audio[i * 2 + 1], input_audio[i * 2 + 1]);
+  }
+
+  // When stretching, one block is consumed per call
+  rubber_band.setPitch(1.5);
+  input_control[AudioRing::kWritePtr].store((4 * block_size) % 1024);
+  rubber_band.process();
+  EXPECT_EQ(input_control[AudioRing::kReadPtr].load(), 3 * block_size);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandCatchUp) {
+  const size_t block_size = 128;
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+  rubber_band.createSharedBuffers(16384, 16384);
+  rubber_band.setPitch(1.5);
+  auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getInputControlPtr());
+  auto *output_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getOutputControlPtr());
+
+  // Worker fell behind: sixty blocks are queued (silence is fine here)
+  input_control[AudioRing::kWritePtr].store(60 * block_size + 17);
+  EXPECT_EQ(rubber_band.process(), 1);
+  EXPECT_EQ(input_control[AudioRing::kReadPtr].load(), block_size);
+
+  // Catch up within a budget of four blocks per call
+  rubber_band.setCatchUp(true, 4);
+  EXPECT_EQ(rubber_band.process(), 4);
+  EXPECT_EQ(input_control[AudioRing::kReadPtr].load(), 5 * block_size);
+
+  // Unlimited budget drains every full block, the partial one stays queued
+  rubber_band.setCatchUp(true, 0);
+  EXPECT_EQ(rubber_band.process(), 55);
+  EXPECT_EQ(input_control[AudioRing::kReadPtr].load(), 60 * block_size);
+  EXPECT_EQ(rubber_band.process(), 0);
+  EXPECT_GT(output_control[AudioRing::kWritePtr].load(), 0);
+}
+
+TEST(RubberbandAPI, ParameterMailbox) {
+  ParameterMailbox mailbox;
+  double value = 0;
+  EXPECT_FALSE(mailbox.hasPending());
+  EXPECT_FALSE(mailbox.take(ParameterMailbox::kPitch, value));
+
+  mailbox.post(ParameterMailbox::kPitch, 1.1);
+  mailbox.post(ParameterMailbox::kPitch, 1.2);
+  mailbox.post(ParameterMailbox::kTempo, 0.9);
+  EXPECT_TRUE(mailbox.hasPending());
+  EXPECT_TRUE(mailbox.take(ParameterMailbox::kPitch, value));
+  EXPECT_EQ(value, 1.2);
+  EXPECT_FALSE(mailbox.take(ParameterMailbox::kPitch, value));
+  EXPECT_FALSE(mailbox.take(ParameterMailbox::kFormantScale, value));
+  EXPECT_TRUE(mailbox.take(ParameterMailbox::kTempo, value));
+  EXPECT_EQ(value, 0.9);
+  EXPECT_FALSE(mailbox.hasPending());
+
+  // Seeded values can be read back but are never taken
+  mailbox.seed(ParameterMailbox::kFormantScale, 1.5);
+  EXPECT_FALSE(mailbox.hasPending());
+  EXPECT_EQ(mailbox.peek(ParameterMailbox::kFormantScale), 1.5);
+  EXPECT_EQ(mailbox.peek(ParameterMailbox::kPitch), 1.2);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandParameterRoundTrip) {
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, 128);
+  EXPECT_EQ(rubber_band.getTempo(), 1.0);
+  EXPECT_EQ(rubber_band.getPitch(), 1.0);
+
+  // Getters return what was set before any block has been processed
+  rubber_band.setTempo(0.8);
+  rubber_band.setPitch(1.25);
+  rubber_band.setFormantScale(0.9);
+  EXPECT_EQ(rubber_band.getTempo(), 0.8);
+  EXPECT_EQ(rubber_band.getPitch(), 1.25);
+  EXPECT_EQ(rubber_band.getFormantScale(), 0.9);
+
+  std::vector<float> buffer(2 * 128);
+  rubber_band.push(reinterpret_cast<uintptr_t>(buffer.data()), 128);
+  EXPECT_EQ(rubber_band.getTempo(), 0.8);
+  EXPECT_EQ(rubber_band.getPitch(), 1.25);
+  EXPECT_EQ(rubber_band.getFormantScale(), 0.9);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandCoalescesParameters) {
+  const size_t block_size = 128;
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+  std::vector<float> buffer(2 * block_size);
+
+  // A slider drag between two render quanta, only the last value matters
+  for (int i = 1; i <= 30; ++i) {
+    rubber_band.setPitch(1.0 + i / 100.0);
+    rubber_band.setTempo(1.0 - i / 100.0);
+  }
+  EXPECT_DOUBLE_EQ(rubber_band.getPitch(), 1.3);
+  EXPECT_DOUBLE_EQ(rubber_band.getTempo(), 0.7);
+
+  rubber_band.push(reinterpret_cast<uintptr_t>(buffer.data()), block_size);
+  EXPECT_DOUBLE_EQ(rubber_band.getPitch(), 1.3);
+  EXPECT_DOUBLE_EQ(rubber_band.getTempo(), 0.7);
+
+  // Invalid values are still rejected right away
+  EXPECT_ANY_THROW(rubber_band.setPitch(0));
+  EXPECT_ANY_THROW(rubber_band.setFormantScale(-1));
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandOverflowPolicy) {
+  const size_t block_size = 512;
+  std::vector<float> buffer(2 * block_size, 0.1f);
+  const auto buffer_ptr = reinterpret_cast<uintptr_t>(buffer.data());
+
+  // Nobody pulls while the stretcher produces four times the input
+  RealtimeRubberBand dropping(48000, 2, false, false, 0, 0, block_size);
+  dropping.setTempo(4.0);
+  for (int i = 0; i < 200; ++i) {
+    EXPECT_TRUE(dropping.push(buffer_ptr, block_size));
+  }
+  EXPECT_GT(dropping.getDroppedFrames(), 0);
+  EXPECT_GT(dropping.getOverflowEvents(), 0);
+
+  RealtimeRubberBand blocking(48000, 2, false, false, 0, 0, block_size);
+  blocking.setTempo(4.0);
+  blocking.setBackpressure(true);
+  int accepted = 0;
+  for (int i = 0; i < 200; ++i) {
+    accepted += blocking.push(buffer_ptr, block_size) ? 1 : 0;
+  }
+  EXPECT_LT(accepted, 200);
+  EXPECT_EQ(blocking.getDroppedFrames(), 0);
+  EXPECT_GT(blocking.getOverflowEvents(), 0);
+
+  // Pulling makes room again
+  for (int i = 0; i < 8; ++i) {
+    blocking.pull(buffer_ptr, block_size);
+  }
+  EXPECT_TRUE(blocking.push(buffer_ptr, block_size));
+
+  // Counters are readable through plain memory
+  auto *counters = reinterpret_cast<const uint32_t *>(dropping.getCountersPtr());
+  EXPECT_EQ(counters[0], dropping.getDroppedFrames());
+  EXPECT_EQ(counters[2], dropping.getOverflowEvents());
+  dropping.resetCounters();
+  EXPECT_EQ(dropping.getDroppedFrames(), 0);
+
+  // Underruns are accounted in frames
+  RealtimeRubberBand starving(48000, 2);
+  starving.pull(buffer_ptr, 128);
+  EXPECT_EQ(starving.getUnderrunFrames(), 128);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandSharedBackpressure) {
+  const size_t block_size = 128;
+  for (bool backpressure : {false, true}) {
+    RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+    rubber_band.createSharedBuffers(16384, 1024);
+    rubber_band.setTempo(2.0);
+    rubber_band.setCatchUp(true, 0);
+    rubber_band.setBackpressure(backpressure);
+    auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getInputControlPtr());
+
+    // Nobody consumes the output ring
+    input_control[AudioRing::kWritePtr].store(100 * block_size);
+    rubber_band.process();
+    rubber_band.process();
+    if (backpressure) {
+      EXPECT_EQ(rubber_band.getDroppedFrames(), 0);
+      EXPECT_LT(input_control[AudioRing::kReadPtr].load(), 100 * block_size);
+    } else {
+      EXPECT_GT(rubber_band.getDroppedFrames(), 0);
+      EXPECT_EQ(input_control[AudioRing::kReadPtr].load(), 100 * block_size);
+    }
+    EXPECT_GT(rubber_band.getOverflowEvents(), 0);
+  }
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandLatency) {
+  RealtimeRubberBand standard(48000, 2, false, false, 0, 0, 512);
+  EXPECT_EQ(standard.getBlockLatency(), 512);
+  EXPECT_GT(standard.getStretcherLatency(), 0);
+  EXPECT_EQ(standard.getInputLatency(), 0);
+  EXPECT_EQ(standard.getOutputLatency(), 0);
+  EXPECT_EQ(standard.getLatency(), standard.getBlockLatency() + standard.getStretcherLatency());
+
+  RealtimeRubberBand monitoring(48000, 2, false, false, 0, 0, 512, RealtimeRubberBand::kProfileLowLatency);
+  EXPECT_EQ(monitoring.getBlockLatency(), 128);
+  EXPECT_LT(monitoring.getLatency(), standard.getLatency());
+
+  // Queued SAB frames count towards the latency as well
+  standard.createSharedBuffers(4096, 4096);
+  auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(standard.getInputControlPtr());
+  input_control[AudioRing::kWritePtr].store(300);
+  EXPECT_EQ(standard.getInputLatency(), 300);
+  EXPECT_EQ(standard.getLatency(), 300 + standard.getBlockLatency() + standard.getStretcherLatency());
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandTelemetry) {
+  const size_t block_size = 128;
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+  rubber_band.createSharedBuffers(4096, 8192);
+  rubber_band.setPitch(1.2);
+  auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(rubber_band.getInputControlPtr());
+  auto *words = reinterpret_cast<const uint32_t *>(rubber_band.getTelemetryPtr());
+  auto *floats = reinterpret_cast<const float *>(rubber_band.getTelemetryPtr());
+
+  // Disabled by default
+  input_control[AudioRing::kWritePtr].store(block_size);
+  rubber_band.process();
+  EXPECT_EQ(words[RealtimeTelemetry::kUpdateCount], 0);
+
+  rubber_band.setTelemetry(true);
+  for (int i = 0; i < 20; ++i) {
+    input_control[AudioRing::kWritePtr].store((i + 2) * block_size);
+    rubber_band.process();
+  }
+  // Nothing to do, only fill levels are updated
+  rubber_band.process();
+
+  // Two steps per update, odd while writing
+  EXPECT_EQ(words[RealtimeTelemetry::kUpdateCount], 42);
+  EXPECT_GT(floats[RealtimeTelemetry::kMaxMicros], 0.0f);
+  EXPECT_GE(floats[RealtimeTelemetry::kMaxMicros], floats[RealtimeTelemetry::kLastMicros]);
+  EXPECT_GT(floats[RealtimeTelemetry::kAverageMicros], 0.0f);
+  EXPECT_FLOAT_EQ(floats[RealtimeTelemetry::kDeadlineMicros], 1e6f * block_size / 48000);
+  EXPECT_EQ(words[RealtimeTelemetry::kInputFill], 0);
+  EXPECT_EQ(words[RealtimeTelemetry::kInputCapacity], 4096);
+  EXPECT_EQ(words[RealtimeTelemetry::kOutputCapacity], 8192);
+  uint32_t timed = 0;
+  for (size_t bin = 0; bin < RealtimeTelemetry::kHistogramBins; ++bin) {
+    timed += words[RealtimeTelemetry::kHistogram + bin];
+    EXPECT_EQ(words[RealtimeTelemetry::kHistogram + bin], rubber_band.getTelemetry().getHistogram(bin));
+  }
+  EXPECT_EQ(timed, 20);
+
+  rubber_band.resetTelemetry();
+  EXPECT_EQ(words[RealtimeTelemetry::kUpdateCount], 0);
+  EXPECT_EQ(rubber_band.getTelemetry().getMaxMicros(), 0.0f);
+}
+
+TEST(RubberbandAPI, RealtimeTelemetrySequenceLock) {
+  RealtimeTelemetry telemetry;
+  EXPECT_EQ(telemetry.getUpdateCount(), 0);
+  for (uint32_t update = 1; update <= 3; ++update) {
+    telemetry.beginUpdate();
+    EXPECT_EQ(telemetry.getUpdateCount() % 2, 1);
+    telemetry.recordTiming(100, 1000);
+    telemetry.recordFill(1, 2, 3, 4);
+    telemetry.recordCounters(5, 6, 7);
+    EXPECT_EQ(telemetry.getUpdateCount() % 2, 1);
+    telemetry.publish();
+    EXPECT_EQ(telemetry.getUpdateCount(), 2 * update);
+  }
+}
+
+TEST(RubberbandAPI, RealtimeRubberBandHost) {
+  const size_t block_size = 128;
+  RealtimeRubberBandHost host(48000, 2, block_size);
+  host.addTrack(false, false, 0, 0, 1024, 1024);
+  host.addTrack(false, false, 0, 0, 1024, 1024);
+  host.addTrack(false, false, 0, 0, 1024, 1024);
+  ASSERT_EQ(host.getTrackCount(), 3);
+  EXPECT_EQ(host.getMixAudioPtr(), 0);
+  host.createMixBus(1024);
+  host.setTrackGain(1, 0.5f);
+  host.setTrackActive(2, false);
+  auto *mix_audio = reinterpret_cast<const float *>(host.getMixAudioPtr());
+  auto *mix_control = reinterpret_cast<std::atomic<int32_t> *>(host.getMixControlPtr());
+
+  // Fill both active tracks, but publish less on the second one: the mix only advances by what all have
+  for (size_t track = 0; track < 2; ++track) {
+    auto *input_audio = reinterpret_cast<float *>(host.getTrack(track)->getInputAudioPtr());
+    auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(host.getTrack(track)->getInputControlPtr());
+    for (size_t i = 0; i < 2 * block_size; ++i) {
+      input_audio[i * 2] = static_cast<float>(track + 1);
+      input_audio[i * 2 + 1] = -static_cast<float>(i) / 1000.0f;
+    }
+    input_control[AudioRing::kWritePtr].store((2 - track) * block_size);
+  }
+
+  // Neutral parameters pass audio through, so the bus holds the gain-weighted sum
+  EXPECT_EQ(host.process(), 3);
+  EXPECT_EQ(mix_control[AudioRing::kWritePtr].load(), block_size);
+  for (size_t i = 0; i < block_size; ++i) {
+    EXPECT_FLOAT_EQ(mix_audio[i * 2], 1.0f + 2.0f * 0.5f);
+    EXPECT_FLOAT_EQ(mix_audio[i * 2 + 1], -1.5f * static_cast<float>(i) / 1000.0f);
+  }
+  EXPECT_EQ(host.getTrack(0)->getOutputRing()->getReadSpace(), block_size);
+
+  // Each track keeps its own parameters
+  host.getTrack(1)->setPitch(1.5);
+  host.process();
+  EXPECT_DOUBLE_EQ(host.getTrack(1)->getPitch(), 1.5);
+  EXPECT_DOUBLE_EQ(host.getTrack(0)->getPitch(), 1.0);
+  EXPECT_THROW(static_cast<void>(host.getTrack(3)), std::out_of_range);
+}
+
+TEST(RubberbandAPI, RealtimeRubberBandHostTrackStates) {
+  const size_t block_size = 128;
+  RealtimeRubberBandHost host(48000, 1, block_size);
+  host.addTrack(false, false, 0, 0, 1024, 1024);
+  host.addTrack(false, false, 0, 0, 1024, 1024);
+  host.createMixBus(1024);
+  auto *mix_audio = reinterpret_cast<const float *>(host.getMixAudioPtr());
+  auto *mix_control = reinterpret_cast<std::atomic<int32_t> *>(host.getMixControlPtr());
+  // Each track gets one block per call, track 1 numbers its blocks
+  size_t block = 0;
+  auto feed = [&](size_t track, float value) {
+    auto *input_audio = reinterpret_cast<float *>(host.getTrack(track)->getInputAudioPtr());
+    auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(host.getTrack(track)->getInputControlPtr());
+    const int32_t write = input_control[AudioRing::kWritePtr].load();
+    for (size_t i = 0; i < block_size; ++i) {
+      input_audio[(write + i) % 1024] = value;
+    }
+    input_control[AudioRing::kWritePtr].store(static_cast<int32_t>((write + block_size) % 1024));
+  };
+  auto mixed = [&]() {
+    const int32_t write = mix_control[AudioRing::kWritePtr].load();
+    const float value = mix_audio[(write + 1024 - 1) % 1024];
+    mix_control[AudioRing::kReadPtr].store(write);
+    return value;
+  };
+
+  // Paused for longer than its output ring: nothing piles up, and it comes back in step
+  host.setTrackActive(1, false);
+  for (; block < 20; ++block) {
+    feed(0, 1.0f);
+    feed(1, 100.0f + static_cast<float>(block));
+    host.process();
+    EXPECT_FLOAT_EQ(mixed(), 1.0f);
+    EXPECT_EQ(host.getTrack(1)->getOutputRing()->getReadSpace(), 0);
+  }
+  EXPECT_EQ(host.getTrack(1)->getDroppedFrames(), 0);
+  host.setTrackActive(1, true);
+  feed(0, 1.0f);
+  feed(1, 100.0f + static_cast<float>(block));
+  host.process();
+  EXPECT_FLOAT_EQ(mixed(), 1.0f + 100.0f + static_cast<float>(block));
+
+  // Track 1 runs dry: the bus carries on with track 0 and counts the underrun on track 1
+  feed(0, 2.0f);
+  host.process();
+  EXPECT_EQ(mix_control[AudioRing::kWritePtr].load() % block_size, 0);
+  EXPECT_FLOAT_EQ(mixed(), 2.0f);
+  EXPECT_EQ(host.getTrack(1)->getUnderrunFrames(), block_size);
+  EXPECT_EQ(host.getTrack(0)->getUnderrunFrames(), 0);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandGovernor) {
+  const size_t block_size = 128;
+  const size_t sample_rate = 48000;
+  RealtimeRubberBand rubber_band(sample_rate, 2, false, false, 0, 0, block_size);
+  rubber_band.createSharedBuffers(4096, 8192);
+  rubber_band.setPitch(1.2);
+  EXPECT_THROW(rubber_band.setGovernor(true, 0.2, 0.5), std::range_error);
+  // Any load is too much
+  rubber_band.setGovernor(true, 1e-9, 1e-10);
+  EXPECT_EQ(rubber_band.getVersion(), 3);
+
+  AudioRing *input = rubber_band.getInputRing();
+  AudioRing *output = rubber_band.getOutputRing();
+  std::vector<float> left(block_size), right(block_size);
+  float *channels[] = {left.data(), right.data()};
+  std::vector<float> played;
+  size_t position = 0;
+  auto run = [&](size_t seconds) {
+    for (size_t block = 0; block < seconds * sample_rate / block_size; ++block) {
+      for (size_t i = 0; i < block_size; ++i, ++position) {
+        left[i] = right[i] = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * position / sample_rate);
+      }
+      input->write(channels, block_size);
+      rubber_band.process();
+      const size_t frames = output->read(channels, std::min(output->getReadSpace(), block_size));
+      played.insert(played.end(), left.begin(), left.begin() + frames);
+    }
+  };
+
+  run(2);
+  EXPECT_EQ(rubber_band.getVersion(), 2);
+  EXPECT_EQ(rubber_band.getEngineSwitches(), 1);
+  EXPECT_GT(rubber_band.getGovernorLoad(), 0.0);
+
+  // Plenty of headroom now
+  rubber_band.setGovernor(true, 1e9, 1e8);
+  run(2);
+  EXPECT_EQ(rubber_band.getVersion(), 3);
+  EXPECT_EQ(rubber_band.getEngineSwitches(), 2);
+
+  // The crossfades keep the sine free of clicks
+  ASSERT_GT(played.size(), 3 * sample_rate);
+  float max_step = 0.0f;
+  for (size_t i = sample_rate / 2 + 1; i < played.size(); ++i) {
+    max_step = std::max(max_step, std::abs(played[i] - played[i - 1]));
+  }
+  EXPECT_LT(max_step, 0.05f);
+  EXPECT_EQ(rubber_band.getDroppedFrames(), 0);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandGovernorPush) {
+  const size_t block_size = 128;
+  const size_t sample_rate = 48000;
+  RealtimeRubberBand rubber_band(sample_rate, 2, false, false, 0, 0, block_size);
+  rubber_band.setPitch(1.2);
+  rubber_band.setGovernor(true, 1e-9, 1e-10);
+
+  std::vector<float> input(2 * block_size), output(2 * block_size);
+  std::vector<float> played;
+  size_t position = 0;
+  auto run = [&](size_t seconds) {
+    for (size_t block = 0; block < seconds * sample_rate / block_size; ++block) {
+      for (size_t i = 0; i < block_size; ++i, ++position) {
+        input[i] = input[block_size + i] =
+            0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * position / sample_rate);
+      }
+      rubber_band.push(reinterpret_cast<uintptr_t>(input.data()), block_size);
+      const size_t frames = std::min(rubber_band.getSamplesAvailable(), block_size);
+      rubber_band.pull(reinterpret_cast<uintptr_t>(output.data()), frames);
+      played.insert(played.end(), output.begin(), output.begin() + frames);
+    }
+  };
+
+  // push() measures its load and switches like process()
+  run(2);
+  EXPECT_EQ(rubber_band.getVersion(), 2);
+  EXPECT_EQ(rubber_band.getEngineSwitches(), 1);
+  EXPECT_GT(rubber_band.getGovernorLoad(), 0.0);
+  rubber_band.setGovernor(true, 1e9, 1e8);
+  run(2);
+  EXPECT_EQ(rubber_band.getVersion(), 3);
+  EXPECT_EQ(rubber_band.getEngineSwitches(), 2);
+
+  ASSERT_GT(played.size(), 3 * sample_rate);
+  float max_step = 0.0f;
+  for (size_t i = sample_rate / 2 + 1; i < played.size(); ++i) {
+    max_step = std::max(max_step, std::abs(played[i] - played[i - 1]));
+  }
+  EXPECT_LT(max_step, 0.05f);
+  EXPECT_EQ(rubber_band.getDroppedFrames(), 0);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandOutputSizing) {
+  const size_t block_size = 512;
+  RealtimeRubberBand rubber_band(192000, 2, false, false, 0, 0, block_size);
+  // One block plus 250 ms of headroom and the burst reserve, far below two seconds per channel
+  const size_t initial = rubber_band.getOutputCapacity();
+  EXPECT_EQ(initial, block_size + 48000 + 8192);
+  EXPECT_LT(rubber_band.getMemoryUsage(), 2 * 192000 * 2 * sizeof(float));
+
+  // Smaller ratios keep the ring, larger ones grow it
+  rubber_band.setTempo(0.5);
+  EXPECT_EQ(rubber_band.getOutputCapacity(), initial);
+  rubber_band.setTempo(2.0);
+  EXPECT_EQ(rubber_band.getOutputCapacity(), 2 * (block_size + 48000) + 8192);
+  rubber_band.setTempo(1.5);
+  EXPECT_EQ(rubber_band.getOutputCapacity(), 2 * (block_size + 48000) + 8192);
+
+  rubber_band.setOutputHeadroom(0);
+  rubber_band.setMaxTimeRatio(4.0);
+  EXPECT_EQ(rubber_band.getOutputCapacity(), 2 * (block_size + 48000) + 8192);
+  rubber_band.setOutputHeadroom(500);
+  EXPECT_EQ(rubber_band.getOutputCapacity(), 4 * (block_size + 96000) + 8192);
+  EXPECT_THROW(rubber_band.setMaxTimeRatio(0), std::range_error);
+
+  // Queued output survives the swap at the next block boundary
+  std::vector<float> buffer(2 * block_size, 0.25f);
+  const auto buffer_ptr = reinterpret_cast<uintptr_t>(buffer.data());
+  for (int i = 0; i < 40; ++i) {
+    rubber_band.push(buffer_ptr, block_size);
+  }
+  const size_t queued = rubber_band.getSamplesAvailable();
+  EXPECT_GT(queued, 0);
+  rubber_band.setTempo(8.0);
+  rubber_band.push(buffer_ptr, block_size);
+  EXPECT_GE(rubber_band.getSamplesAvailable(), queued);
+  EXPECT_EQ(rubber_band.getDroppedFrames(), 0);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandSeekAndDrain) {
+  const size_t block_size = 512;
+  std::vector<float> buffer(2 * block_size, 0.25f);
+  const auto buffer_ptr = reinterpret_cast<uintptr_t>(buffer.data());
+
+  for (const int profile : {RealtimeRubberBand::kProfileDefault, RealtimeRubberBand::kProfileLowLatency}) {
+    for (const double tempo : {0.5, 1.0, 2.0}) {
+      RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size, profile);
+      rubber_band.setTempo(tempo);
+      rubber_band.setPitch(1.5);
+      for (int i = 0; i < 20; ++i) {
+        rubber_band.push(buffer_ptr, rubber_band.getBlockLatency());
+      }
+      EXPECT_GT(rubber_band.getSamplesAvailable(), 0);
+
+      // Seek: nothing is left over, and the pre-roll gets the first render quantum out right away
+      rubber_band.flush();
+      EXPECT_EQ(rubber_band.getSamplesAvailable(), 0);
+      const size_t preroll_size = rubber_band.getPrerollSize();
+      std::vector<float> preroll(2 * preroll_size, 0.25f);
+      const size_t consumed = rubber_band.preroll(reinterpret_cast<uintptr_t>(preroll.data()), preroll_size);
+      EXPECT_LE(consumed, preroll_size);
+      EXPECT_GE(rubber_band.getSamplesAvailable(), 128) << "profile " << profile << ", tempo " << tempo;
+    }
+  }
+
+  // drain() hands out the tail: all input ends up in the output (plus the stretcher's lead-in and tail)
+  RealtimeRubberBand rubber_band(48000, 2, false, false, 0, 0, block_size);
+  rubber_band.setTempo(1.5);
+  rubber_band.setPitch(1.2);
+  const size_t blocks = 20;
+  std::vector<float> output(2 * 32768);
+  size_t pulled = 0;
+  for (size_t i = 0; i < blocks; ++i) {
+    rubber_band.push(buffer_ptr, block_size);
+    const size_t available = rubber_band.getSamplesAvailable();
+    pulled += available;
+    rubber_band.pull(reinterpret_cast<uintptr_t>(output.data()), available);
+  }
+  const size_t before_drain = pulled;
+  rubber_band.drain();
+  pulled += rubber_band.getSamplesAvailable();
+  EXPECT_GT(pulled, before_drain + rubber_band.getStretcherLatency());
+  EXPECT_GE(static_cast<double>(pulled), 1.5 * blocks * block_size);
+  // Ready for the next stream
+  rubber_band.pull(reinterpret_cast<uintptr_t>(output.data()), rubber_band.getSamplesAvailable());
+  for (size_t i = 0; i < blocks; ++i) {
+    rubber_band.push(buffer_ptr, block_size);
+  }
+  EXPECT_GT(rubber_band.getSamplesAvailable(), 0);
+
+  // The SAB path drains the partial block left in the input ring
+  RealtimeRubberBand shared(48000, 2, false, false, 0, 0, 128);
+  shared.createSharedBuffers(8192, 16384);
+  shared.setPitch(1.2);
+  auto *input_control = reinterpret_cast<std::atomic<int32_t> *>(shared.getInputControlPtr());
+  input_control[AudioRing::kWritePtr].store(4000);
+  shared.setCatchUp(true, 0);
+  shared.process();
+  EXPECT_EQ(shared.getInputRing()->getReadSpace(), 4000 % 128);
+  shared.drain();
+  EXPECT_EQ(shared.getInputRing()->getReadSpace(), 0);
+  EXPECT_GE(shared.getOutputRing()->getReadSpace(), 4000);
+  const size_t tail = shared.getOutputRing()->getReadSpace();
+
+  // Seeking drops queued SAB input
+  input_control[AudioRing::kWritePtr].store(5000);
+  shared.flush();
+  EXPECT_EQ(shared.getInputRing()->getReadSpace(), 0);
+
+  // With backpressure a full output ring pauses the drain instead of dropping the tail
+  RealtimeRubberBand limited(48000, 2, false, false, 0, 0, 128);
+  limited.createSharedBuffers(8192, 1024);
+  limited.setPitch(1.2);
+  limited.setBackpressure(true);
+  auto *limited_control = reinterpret_cast<std::atomic<int32_t> *>(limited.getInputControlPtr());
+  limited_control[AudioRing::kWritePtr].store(4000);
+  limited.setCatchUp(true, 0);
+  size_t drained = 0;
+  size_t incomplete = 0;
+  while (true) {
+    limited.process();
+    const bool done = limited.drain();
+    drained += limited.getOutputRing()->getReadSpace();
+    limited.getOutputRing()->skip(limited.getOutputRing()->getReadSpace());
+    if (done) break;
+    ++incomplete;
+    // Nothing is taken while the tail is pending
+    EXPECT_EQ(limited.process(), 0);
+  }
+  EXPECT_GT(incomplete, 0);
+  EXPECT_EQ(drained, tail);
+  EXPECT_EQ(limited.getDroppedFrames(), 0);
+  limited_control[AudioRing::kWritePtr].store(4000 + 128);
+  EXPECT_EQ(limited.process(), 1);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandSilenceGate) {
+  const size_t block_size = 128;
+  const size_t sample_rate = 48000;
+  RealtimeRubberBand rubber_band(sample_rate, 2, false, false, 0, 0, block_size);
+  rubber_band.createSharedBuffers(4096, 8192);
+  rubber_band.setPitch(1.2);
+  rubber_band.setTempo(1.5);
+  rubber_band.setSilenceGate(true);
+
+  AudioRing *input = rubber_band.getInputRing();
+  AudioRing *output = rubber_band.getOutputRing();
+  std::vector<float> left(block_size), right(block_size), out_left(2048), out_right(2048);
+  float *channels[] = {left.data(), right.data()};
+  float *out_channels[] = {out_left.data(), out_right.data()};
+  size_t position = 0;
+  size_t produced = 0;
+  size_t produced_after_resume = 0;
+  bool heard_after_resume = false;
+  // One second of signal, two of silence, one of signal
+  for (size_t second = 0; second < 4; ++second) {
+    const bool silent = second == 1 || second == 2;
+    for (size_t block = 0; block < sample_rate / block_size; ++block) {
+      for (size_t i = 0; i < block_size; ++i, ++position) {
+        left[i] = right[i] = silent ? 0.0f : 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f *
+            static_cast<float>(position) / sample_rate);
+      }
+      input->write(channels, block_size);
+      rubber_band.process();
+      const size_t frames = output->read(out_channels, output->getReadSpace());
+      produced += frames;
+      if (second == 3) {
+        produced_after_resume += frames;
+        for (size_t i = 0; i < frames; ++i) {
+          heard_after_resume |= std::abs(out_left[i]) > 0.1f;
+        }
+      }
+    }
+  }
+  // The silent part minus the stretcher latency was skipped, and the output kept its length
+  EXPECT_GT(rubber_band.getSkippedBlocks(), sample_rate / block_size);
+  EXPECT_LT(rubber_band.getSkippedBlocks(), 2 * sample_rate / block_size);
+  EXPECT_NEAR(static_cast<double>(produced), 1.5 * static_cast<double>(position), 1.5 * 8192);
+  EXPECT_TRUE(heard_after_resume);
+  EXPECT_GT(produced_after_resume, sample_rate);
+  EXPECT_EQ(reinterpret_cast<const uint32_t *>(rubber_band.getCountersPtr())[3], rubber_band.getSkippedBlocks());
+  EXPECT_EQ(rubber_band.getDroppedFrames(), 0);
+
+  // push() gates as well
+  RealtimeRubberBand pushed(sample_rate, 2, false, false, 0, 0, 512);
+  pushed.setTempo(2.0);
+  pushed.setSilenceGate(true);
+  std::vector<float> silence(2 * 512, 0.0f);
+  for (int i = 0; i < 40; ++i) {
+    pushed.push(reinterpret_cast<uintptr_t>(silence.data()), 512);
+    std::vector<float> sink(2 * 8192);
+    pushed.pull(reinterpret_cast<uintptr_t>(sink.data()), pushed.getSamplesAvailable());
+  }
+  EXPECT_GT(pushed.getSkippedBlocks(), 20);
+
+  // With backpressure gated zeros that do not fit are refused like any other input, not dropped
+  RealtimeRubberBand limited(sample_rate, 2, false, false, 0, 0, 512);
+  limited.setTempo(2.0);
+  limited.setSilenceGate(true);
+  limited.setBackpressure(true);
+  bool refused = false;
+  for (int i = 0; i < 200 && !refused; ++i) {
+    refused = !limited.push(reinterpret_cast<uintptr_t>(silence.data()), 512);
+  }
+  EXPECT_TRUE(refused);
+  EXPECT_GT(limited.getSkippedBlocks(), 0);
+  EXPECT_EQ(limited.getDroppedFrames(), 0);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandSilenceGateAfterFlush) {
+  const size_t block_size = 256;
+  const size_t sample_rate = 48000;
+  RealtimeRubberBand rubber_band(sample_rate, 1, false, false, 0, 0, block_size);
+  rubber_band.setTempo(1.5);
+  rubber_band.setSilenceGate(true);
+  std::vector<float> input(block_size), output(2 * block_size);
+  size_t position = 0;
+  auto run = [&](size_t seconds, bool silent) {
+    for (size_t block = 0; block < seconds * sample_rate / block_size; ++block) {
+      for (size_t i = 0; i < block_size; ++i, ++position) {
+        input[i] = silent ? 0.0f :
+            0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * static_cast<float>(position) / sample_rate);
+      }
+      rubber_band.push(reinterpret_cast<uintptr_t>(input.data()), block_size);
+      rubber_band.pull(reinterpret_cast<uintptr_t>(output.data()), rubber_band.getSamplesAvailable());
+    }
+  };
+
+  // Seek back to the start during a gated passage: the silence after it is gated again as soon as the
+  // stretcher latency has passed, not once the output got back to where the old silence began
+  run(3, false);
+  run(2, true);
+  const size_t skipped = rubber_band.getSkippedBlocks();
+  EXPECT_GT(skipped, 0);
+  rubber_band.flush();
+  run(1, true);
+  EXPECT_GT(rubber_band.getSkippedBlocks(), skipped + sample_rate / block_size / 2);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandSilenceGateShortRatio) {
+  // At a time ratio of 0.25 the stretcher needs four times its start delay in input to get the tail out: the
+  // gated output matches the ungated one
+  const size_t block_size = 256;
+  const size_t sample_rate = 48000;
+  std::vector<std::vector<float>> outputs;
+  size_t skipped = 0;
+  for (const bool gated : {false, true}) {
+    RealtimeRubberBand rubber_band(sample_rate, 1, false, false, 0, 0, block_size);
+    rubber_band.setTempo(0.25);
+    rubber_band.setPitch(1.2);
+    rubber_band.setSilenceGate(gated);
+    std::vector<float> input(block_size), output(block_size), result;
+    for (size_t block = 0, position = 0; block < sample_rate / block_size; ++block) {
+      for (size_t i = 0; i < block_size; ++i, ++position) {
+        input[i] = position < sample_rate / 4 ?
+            0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * static_cast<float>(position) / sample_rate) :
+            0.0f;
+      }
+      rubber_band.push(reinterpret_cast<uintptr_t>(input.data()), block_size);
+      const size_t available = rubber_band.getSamplesAvailable();
+      rubber_band.pull(reinterpret_cast<uintptr_t>(output.data()), available);
+      result.insert(result.end(), output.begin(), output.begin() + available);
+    }
+    skipped = rubber_band.getSkippedBlocks();
+    outputs.push_back(result);
+  }
+  EXPECT_GT(skipped, 0);
+  const size_t length = std::min(outputs[0].size(), outputs[1].size());
+  float difference = 0;
+  for (size_t i = 0; i < length; ++i) {
+    difference = std::max(difference, std::abs(outputs[0][i] - outputs[1][i]));
+  }
+
+  EXPECT_LT(difference, 1e-3f);
+}
+
+TEST(RubberbandAPI, RealtimeRubberbandInterleaved) {
+  const size_t block_size = 128;
+  RealtimeRubberBand planar(48000, 2, false, false, 0, 0, block_size);
+  RealtimeRubberBand interleaved(48000, 2, false, false, 0, 0, block_size);
+  planar.setPitch(1.2);
+  interleaved.setPitch(1.2);
+
+  // Both see the same samples, once as planar float and once as interleaved int16
+  std::vector<int16_t> input(2 * block_size);
+  std::vector<float> planar_input(2 * block_size);
+  std::vector<float> planar_output(2 * block_size);
+  std::vector<int16_t> expected(2 * block_size);
+  std::vector<int16_t> output(2 * block_size);
+  for (size_t block = 0; block < 100; ++block) {
+    for (size_t i = 0; i < block_size; ++i) {
+      const double t = static_cast<double>(block * block_size + i) / 48000;
+      input[2 * i] = static_cast<int16_t>(16000 * std::sin(2 * M_PI * 440 * t));
+      input[2 * i + 1] = static_cast<int16_t>(8000 * std::sin(2 * M_PI * 660 * t));
+      planar_input[i] = static_cast<float>(input[2 * i]) / 32768.0f;
+      planar_input[block_size + i] = static_cast<float>(input[2 * i + 1]) / 32768.0f;
+    }
+    planar.push(reinterpret_cast<uintptr_t>(planar_input.data()), block_size);
+    interleaved.pushInterleaved(reinterpret_cast<uintptr_t>(input.data()), block_size, SampleFormat::kInt16);
+    planar.pull(reinterpret_cast<uintptr_t>(planar_output.data()), block_size);
+    interleaved.pullInterleaved(reinterpret_cast<uintptr_t>(output.data()), block_size, SampleFormat::kInt16);
+    const float *channels[] = {planar_output.data(), planar_output.data() + block_size};
+    interleavePcmScalar(channels, 0, expected.data(), SampleFormat::kInt16, 2, block_size);
+    ASSERT_EQ(output, expected) << block;
+  }
+  EXPECT_GT(*std::max_element(output.begin(), output.end()), 1000);
+
+  // The staging block holds one block
+  EXPECT_THROW(interleaved.pushInterleaved(reinterpret_cast<uintptr_t>(input.data()), block_size + 1,
+                                           SampleFormat::kInt16), std::range_error);
+}
+
+#if defined(__SSE__)
+#include "DenormalGuard.h"
+
+TEST(RubberbandAPI, DenormalGuard) {
+  volatile float tiny = 1e-37f;
+  {
+    DenormalGuard guard;
+    EXPECT_EQ(tiny * 1e-3f, 0.0f);
+  }
+  EXPECT_GT(tiny * 1e-3f, 0.0f);
+}
+#endif
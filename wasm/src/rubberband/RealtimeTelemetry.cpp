@@ -0,0 +1,95 @@
+//
+// Per-instance DSP load and xrun telemetry, written by the audio thread into WASM memory.
+//
+
+#include "RealtimeTelemetry.h"
+
+static_assert(sizeof(std::atomic<float>) == 4 && sizeof(std::atomic<uint32_t>) == 4,
+              "Telemetry words must be 32 bit");
+static_assert(sizeof(RealtimeTelemetry) == RealtimeTelemetry::kWordCount * 4,
+              "Telemetry fields must match the word layout");
+
+const uint32_t RealtimeTelemetry::kBinLimits[kHistogramBins - 1] = {10, 25, 50, 75, 100, 150, 200};
+
+// Weight of the newest value in the moving average
+const float kAverageWeight = 1.0f / 32.0f;
+
+RealtimeTelemetry::RealtimeTelemetry() {
+  reset();
+}
+
+void RealtimeTelemetry::beginUpdate() {
+  update_count_.fetch_add(1, std::memory_order_relaxed);
+  // Keeps the field stores below from becoming visible before the odd count
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void RealtimeTelemetry::recordTiming(double micros, double deadline_micros) {
+  const auto value = static_cast<float>(micros);
+  const float average = average_micros_.load(std::memory_order_relaxed);
+  last_micros_.store(value, std::memory_order_relaxed);
+  average_micros_.store(average == 0 ? value : average + (value - average) * kAverageWeight,
+                        std::memory_order_relaxed);
+  if (value > max_micros_.load(std::memory_order_relaxed)) {
+    max_micros_.store(value, std::memory_order_relaxed);
+  }
+  deadline_micros_.store(static_cast<float>(deadline_micros), std::memory_order_relaxed);
+
+  const double percent = deadline_micros > 0 ? 100.0 * micros / deadline_micros : 0;
+  size_t bin = 0;
+  while (bin < kHistogramBins - 1 && percent >= kBinLimits[bin]) {
+    ++bin;
+  }
+  histogram_[bin].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RealtimeTelemetry::recordFill(size_t input_fill, size_t input_capacity,
+                                   size_t output_fill, size_t output_capacity) {
+  input_fill_.store(input_fill, std::memory_order_relaxed);
+  input_capacity_.store(input_capacity, std::memory_order_relaxed);
+  output_fill_.store(output_fill, std::memory_order_relaxed);
+  output_capacity_.store(output_capacity, std::memory_order_relaxed);
+}
+
+void RealtimeTelemetry::recordCounters(uint32_t underrun_frames, uint32_t overflow_events, uint32_t dropped_frames) {
+  underrun_frames_.store(underrun_frames, std::memory_order_relaxed);
+  overflow_events_.store(overflow_events, std::memory_order_relaxed);
+  dropped_frames_.store(dropped_frames, std::memory_order_relaxed);
+}
+
+void RealtimeTelemetry::publish() {
+  update_count_.fetch_add(1, std::memory_order_release);
+}
+
+void RealtimeTelemetry::reset() {
+  update_count_.store(0, std::memory_order_relaxed);
+  last_micros_.store(0, std::memory_order_relaxed);
+  average_micros_.store(0, std::memory_order_relaxed);
+  max_micros_.store(0, std::memory_order_relaxed);
+  deadline_micros_.store(0, std::memory_order_relaxed);
+  recordFill(0, 0, 0, 0);
+  recordCounters(0, 0, 0);
+  for (auto &bin : histogram_) {
+    bin.store(0, std::memory_order_relaxed);
+  }
+}
+
+uint32_t RealtimeTelemetry::getUpdateCount() const {
+  return update_count_.load(std::memory_order_acquire);
+}
+
+float RealtimeTelemetry::getLastMicros() const {
+  return last_micros_.load(std::memory_order_relaxed);
+}
+
+float RealtimeTelemetry::getAverageMicros() const {
+  return average_micros_.load(std::memory_order_relaxed);
+}
+
+float RealtimeTelemetry::getMaxMicros() const {
+  return max_micros_.load(std::memory_order_relaxed);
+}
+
+uint32_t RealtimeTelemetry::getHistogram(size_t bin) const {
+  return histogram_[bin].load(std::memory_order_relaxed);
+}
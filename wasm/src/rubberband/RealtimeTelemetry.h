@@ -0,0 +1,84 @@
+//
+// Per-instance DSP load and xrun telemetry, written by the audio thread into WASM memory.
+//
+// Every field is 32 bit, so the main thread can read the block through a Uint32Array and a Float32Array
+// over the same kWordCount words without any messaging. update_count is a sequence lock: it is odd while the
+// audio thread writes and even once an update is complete. Readers retry while it is odd or has changed between
+// reading it before and after the other fields.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_REALTIMETELEMETRY_H_
+#define WASM_SRC_RUBBERBAND_REALTIMETELEMETRY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+class RealtimeTelemetry {
+ public:
+  // Upper bounds of the histogram bins in percent of the block deadline, the last bin is open
+  static const size_t kHistogramBins = 8;
+  static const uint32_t kBinLimits[kHistogramBins - 1];
+
+  // Word indices as seen from JS
+  enum Word {
+    kUpdateCount = 0,   // u32
+    kLastMicros,        // f32, last process()/push() duration
+    kAverageMicros,     // f32, exponential moving average
+    kMaxMicros,         // f32
+    kDeadlineMicros,    // f32, duration of the audio handled by the last call
+    kInputFill,         // u32, frames
+    kInputCapacity,     // u32, frames
+    kOutputFill,        // u32, frames
+    kOutputCapacity,    // u32, frames
+    kUnderrunFrames,    // u32
+    kOverflowEvents,    // u32
+    kDroppedFrames,     // u32
+    kHistogram,         // u32[kHistogramBins], calls per bin
+    kWordCount = kHistogram + kHistogramBins
+  };
+
+  RealtimeTelemetry();
+
+  // Audio thread: starts an update, makes update_count odd before any record*() call
+  void beginUpdate();
+
+  // One call took micros to handle deadline_micros worth of audio
+  void recordTiming(double micros, double deadline_micros);
+
+  void recordFill(size_t input_fill, size_t input_capacity, size_t output_fill, size_t output_capacity);
+
+  void recordCounters(uint32_t underrun_frames, uint32_t overflow_events, uint32_t dropped_frames);
+
+  // Completes the update, makes update_count even again
+  void publish();
+
+  void reset();
+
+  [[nodiscard]] uint32_t getUpdateCount() const;
+
+  [[nodiscard]] float getLastMicros() const;
+
+  [[nodiscard]] float getAverageMicros() const;
+
+  [[nodiscard]] float getMaxMicros() const;
+
+  [[nodiscard]] uint32_t getHistogram(size_t bin) const;
+
+ private:
+  std::atomic<uint32_t> update_count_;
+  std::atomic<float> last_micros_;
+  std::atomic<float> average_micros_;
+  std::atomic<float> max_micros_;
+  std::atomic<float> deadline_micros_;
+  std::atomic<uint32_t> input_fill_;
+  std::atomic<uint32_t> input_capacity_;
+  std::atomic<uint32_t> output_fill_;
+  std::atomic<uint32_t> output_capacity_;
+  std::atomic<uint32_t> underrun_frames_;
+  std::atomic<uint32_t> overflow_events_;
+  std::atomic<uint32_t> dropped_frames_;
+  std::atomic<uint32_t> histogram_[kHistogramBins];
+};
+
+#endif //WASM_SRC_RUBBERBAND_REALTIMETELEMETRY_H_
@@ -5,8 +5,9 @@
 #ifndef WASM_SRC_RUBBERBANDAPI_H_
 #define WASM_SRC_RUBBERBANDAPI_H_
 
-#include <RubberBandStretcher.h>
-#include <queue>
+#include <cstddef>
+#include <cstdint>
+#include "OfflineRubberBand.h"
 
 class RubberBandAPI {
  public:
@@ -27,12 +28,13 @@ class RubberBandAPI {
 
   [[nodiscard]] size_t getSamplesRequired() const;
 
+  // NaN and Inf samples processed as silence so far
+  [[nodiscard]] size_t getNonFiniteSampleCount() const;
+
   void setMaxProcessSize(size_t size) const;
 
  private:
-  bool validate(const float *const *input, size_t input_size);
-
-  RubberBand::RubberBandStretcher *stretcher_;
+  OfflineRubberBand *rubber_band_;
 
   static const size_t kSampleSize = 128;
 };
@@ -2,7 +2,8 @@
 // Created by Tobias Hegemann on 03.11.22.
 //
 
-#include <iostream>
+#include <algorithm>
+#include <utility>
 #include "RubberBandFinal.h"
 
 const RubberBand::RubberBandStretcher::Options kOptions = RubberBand::RubberBandStretcher::OptionProcessOffline |
@@ -12,84 +13,80 @@ RubberBandFinal::RubberBandFinal(size_t sample_rate,
                                  size_t channel_count,
                                  size_t sample_count,
                                  double time_ratio,
-                                 double pitch_scale) {
-  stretcher_ = new RubberBand::RubberBandStretcher(sample_rate, channel_count, kOptions);
-  stretcher_->setTimeRatio(time_ratio);
-  stretcher_->setPitchScale(pitch_scale);
-  input_size_ = sample_count;
-  output_size_ = sample_count * time_ratio; // NOLINT(cppcoreguidelines-narrowing-conversions)
-  input_ = new float *[channel_count];
-  output_ = new float *[channel_count];
-  output_buffer_ = new float *[channel_count];
-  input_buffer_ = new float *[channel_count];
-  for (size_t channel = 0; channel < channel_count; ++channel) {
-    input_[channel] = new float[input_size_];
-    output_[channel] = new float[output_size_];
-    input_buffer_[channel] = new float[8192];
-    output_buffer_[channel] = new float[8192];
-  }
+                                 double pitch_scale)
+    : channel_count_(channel_count),
+      input_size_(sample_count) {
+  rubber_band_ = new OfflineRubberBand(sample_rate, channel_count, time_ratio, pitch_scale, kOptions);
 }
 
 RubberBandFinal::~RubberBandFinal() {
-  delete stretcher_;
-  delete[] input_;
-  delete[] output_;
-  delete[] input_buffer_;
-  delete[] output_buffer_;
+  delete rubber_band_;
+  if (input_ != nullptr) {
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      delete[] input_[channel];
+    }
+    delete[] input_;
+  }
 }
 
 void RubberBandFinal::push(uintptr_t input_ptr, size_t input_size) {
-  auto input = reinterpret_cast<float **>(input_ptr);
-  // Build up internal array since final is signaled
-  for (size_t channel = 0; channel < stretcher_->getChannelCount(); ++channel) {
-    for (size_t sample = 0; sample < input_size; ++sample) {
-      //TODO: THIS WILL BREAK:
-      auto value = input[channel][sample];
-      // END OF TODO
-      input_[channel][input_write_pos_ + sample] = value;
-    }
+  auto input = reinterpret_cast<const float *const *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
+  const size_t frames = reserveInput(input_size);
+  for (size_t channel = 0; channel < channel_count_; ++channel) {
+    std::copy(input[channel], input[channel] + frames, input_[channel] + input_write_pos_);
   }
-  input_write_pos_ += input_size;
-  /*
-  const auto final = input_write_pos_ >= input_size_;
-  stretcher_->study(input, input_size, final);
-  if (final) {
-    // End reached, process all now
-    size_t sample_required = stretcher_->getSamplesRequired();
-    while (sample_required > 0) {
-      for (size_t channel = 0; channel < stretcher_->getChannelCount(); ++channel) {
-        input_buffer_[channel] = input_[channel] + input_process_pos_;
-      }
-      stretcher_->process(input_buffer_, sample_required, input_process_pos_ + sample_required >= input_size_);
-      input_process_pos_ += sample_required;
-      fetch();
-      sample_required = stretcher_->getSamplesRequired();
-    }
-    fetch();
-  }*/
+  commitInput(frames);
 }
 
-bool RubberBandFinal::pull(uintptr_t output_ptr, size_t output_size) {
-  auto output = reinterpret_cast<float **>(output_ptr);
-  for (size_t channel = 0; channel < stretcher_->getChannelCount(); ++channel) {
-    output[channel] = output_[channel] + output_read_pos_;
-  }
-  output_read_pos_ += output_size;
-  return output_read_pos_ >= output_size;
+void RubberBandFinal::pushInterleaved(uintptr_t input_ptr, size_t input_size, SampleFormat sample_format) {
+  auto input = reinterpret_cast<const void *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
+  const size_t frames = reserveInput(input_size);
+  deinterleavePcm(input, sample_format, input_, input_write_pos_, channel_count_, frames);
+  commitInput(frames);
 }
 
-void RubberBandFinal::fetch() {
-  auto input_buffer = new const float *;
-  auto available = stretcher_->available();
-  while (available > 0) {
-    auto actual = stretcher_->retrieve(output_buffer_, available);
-    for (size_t channel = 0; channel < stretcher_->getChannelCount(); ++channel) {
-      for (size_t sample = 0; sample < actual; ++sample) {
-        output_[channel][output_write_pos_ + sample] = output_buffer_[channel][sample];
-      }
+size_t RubberBandFinal::reserveInput(size_t input_size) {
+  if (input_ == nullptr) {
+    input_ = new float *[channel_count_];
+    for (size_t channel = 0; channel < channel_count_; ++channel) {
+      input_[channel] = new float[input_size_];
     }
-    output_write_pos_ += actual;
-    available = stretcher_->available();
+  }
+  return std::min(input_size, input_size_ - input_write_pos_);
+}
+
+void RubberBandFinal::commitInput(size_t frame_count) {
+  input_write_pos_ += frame_count;
+  if (frame_count > 0 && input_write_pos_ >= input_size_) {
+    // Complete, study now and render on pull()
+    rubber_band_->setInput(input_, input_size_);
   }
 }
 
+void RubberBandFinal::setInputCallback(OfflineRubberBand::InputCallback input_callback) {
+  rubber_band_->setInput(std::move(input_callback), input_size_);
+}
+
+#ifdef __EMSCRIPTEN__
+void RubberBandFinal::setInputCallback(emscripten::val read) {
+  setInputCallback([read](float *const *destination, size_t input_frame, size_t frame_count) {
+    return read(reinterpret_cast<uintptr_t>(destination), input_frame, frame_count).as<size_t>();
+  });
+}
+#endif
+
+bool RubberBandFinal::pull(uintptr_t output_ptr, size_t output_size) {
+  auto output = reinterpret_cast<float *const *>(output_ptr); // NOLINT(performance-no-int-to-ptr)
+  rubber_band_->render(output, 0, output_size);
+  return rubber_band_->isFinished();
+}
+
+bool RubberBandFinal::pullInterleaved(uintptr_t output_ptr, size_t output_size, SampleFormat sample_format) {
+  auto output = reinterpret_cast<void *>(output_ptr); // NOLINT(performance-no-int-to-ptr)
+  rubber_band_->renderInterleaved(output, sample_format, output_size);
+  return rubber_band_->isFinished();
+}
+
+size_t RubberBandFinal::getNonFiniteSampleCount() const {
+  return rubber_band_->getNonFiniteSampleCount();
+}
@@ -5,7 +5,13 @@
 #ifndef WASM_SRC_RUBBERBANDFINAL_H_
 #define WASM_SRC_RUBBERBANDFINAL_H_
 
-#include <RubberBandStretcher.h>
+#include <cstddef>
+#include <cstdint>
+#include "OfflineRubberBand.h"
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/val.h>
+#endif
 
 class RubberBandFinal {
  public:
@@ -16,26 +22,43 @@ class RubberBandFinal {
                   double pitch_scale);
   ~RubberBandFinal();
 
+  // Collects the input, the pushed buffers may be reused as soon as push() returns
   void push(uintptr_t input_ptr, size_t input_size);
 
+  // push() for interleaved samples in sample_format, converted straight into the collected input
+  void pushInterleaved(uintptr_t input_ptr, size_t input_size, SampleFormat sample_format);
+
+  // Instead of push(): streams the sample_count input frames through the callback, nothing of the input is kept
+  void setInputCallback(OfflineRubberBand::InputCallback input_callback);
+
+#ifdef __EMSCRIPTEN__
+  // read(channelPtrsPtr, inputFrame, frameCount) fills the planar buffers and returns the frames written
+  void setInputCallback(emscripten::val read);
+#endif
+
+  // Renders the next output_size frames into the caller's planar output, returns true once all output is rendered
   bool pull(uintptr_t output_ptr, size_t output_size);
 
+  // Same into an interleaved output in sample_format
+  bool pullInterleaved(uintptr_t output_ptr, size_t output_size, SampleFormat sample_format);
+
+  // NaN and Inf input samples rendered as silence so far
+  [[nodiscard]] size_t getNonFiniteSampleCount() const;
+
  private:
-  void fetch();
+  // Makes room for the whole input, returns the frames of input_size that still fit
+  size_t reserveInput(size_t input_size);
+  // Studies once the input is complete
+  void commitInput(size_t frame_count);
 
+  size_t channel_count_;
   size_t input_size_;
   size_t input_write_pos_ = 0;
-  size_t input_process_pos_ = 0;
-  float **input_buffer_;
-
-  float **input_;
-  float **output_;
-  size_t output_write_pos_ = 0;
-  size_t output_read_pos_ = 0;
-  float **output_buffer_;
-  size_t output_size_;
+  // Offline processing needs the whole input after the study, so pushed input gets the only full-length copy.
+  // Allocated by the first push().
+  float **input_ = nullptr;
 
-  RubberBand::RubberBandStretcher *stretcher_;
+  OfflineRubberBand *rubber_band_;
 };
 
 #endif //WASM_SRC_RUBBERBANDFINAL_H_
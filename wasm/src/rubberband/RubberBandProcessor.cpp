@@ -1,62 +1,57 @@
 
 #include "RubberBandProcessor.h"
-
-const RubberBand::RubberBandStretcher::Options kOptions = RubberBand::RubberBandStretcher::OptionProcessOffline |
-    RubberBand::RubberBandStretcher::OptionPitchHighConsistency |
-    RubberBand::RubberBandStretcher::OptionEngineFiner;
+#include "ParallelOfflineRubberBand.h"
 
 RubberBandProcessor::RubberBandProcessor(size_t sample_rate,
                                          size_t channel_count,
                                          double time_ratio,
-                                         double pitch_scale) {
-  stretcher_ = new RubberBand::RubberBandStretcher(sample_rate, channel_count, kOptions);
-  stretcher_->setTimeRatio(time_ratio);
-  stretcher_->setPitchScale(pitch_scale);
-  scratch_ = new float *[channel_count];
-  for (size_t channel = 0; channel < channel_count; ++channel) {
-    scratch_[channel] = new float[8192 * 3];
-  }
-  output_ = new float *;
+                                         double pitch_scale)
+    : sample_rate_(sample_rate),
+      channel_count_(channel_count) {
+  rubber_band_ = new OfflineRubberBand(sample_rate, channel_count, time_ratio, pitch_scale);
 }
 
 RubberBandProcessor::~RubberBandProcessor() {
-  delete stretcher_;
-  delete scratch_;
-  delete output_;
+  delete rubber_band_;
 }
 
-size_t RubberBandProcessor::setBuffer(uintptr_t input_ptr, size_t input_size) {
-  input_size_ = input_size;
-  output_size_ = input_size_ * stretcher_->getTimeRatio(); // NOLINT(cppcoreguidelines-narrowing-conversions)
-  input_processed_counter_ = 0;
-  output_fetched_counter_ = 0;
-
-  auto channel_count = stretcher_->getChannelCount();
-
-  input_ = reinterpret_cast<float **>(input_ptr);
-  for (int channel = 0; channel < channel_count; ++channel) {
-    output_[channel] = new float[output_size_];
-  }
+void RubberBandProcessor::setThreadCount(size_t thread_count) {
+  // Segments only pay off when they really render in parallel, see setBuffer()
+  thread_count_ = ParallelOfflineRubberBand::resolveThreadCount(thread_count);
+}
 
-  stretcher_->study(input_, input_size_, true);
+void RubberBandProcessor::addKeyFrame(size_t input_frame, size_t output_frame) {
+  auto key_frames = key_frames_;
+  key_frames[input_frame] = output_frame;
+  rubber_band_->setKeyFrameMap(key_frames);
+  key_frames_ = key_frames;
+}
 
-  // Simple first: Process and store ALL
-  auto sample_required = stretcher_->getSamplesRequired();
-  while (sample_required > 0) {
-    auto input = new const float *;
-    for (size_t channel = 0; channel < channel_count; ++channel) {
-      input[channel] = input_[channel] + input_processed_counter_;
-    }
-    stretcher_->process(input, sample_required, input_processed_counter_ + sample_required >= input_size_);
-    input_processed_counter_ += sample_required; // NOLINT(cppcoreguidelines-narrowing-conversions)
-    tryFetch();
-    sample_required = stretcher_->getSamplesRequired();
-  }
+void RubberBandProcessor::clearKeyFrames() {
+  key_frames_.clear();
+  rubber_band_->setKeyFrameMap(key_frames_);
+}
 
-  while (output_fetched_counter_ < output_size_) {
-    tryFetch();
+size_t RubberBandProcessor::setBuffer(uintptr_t input_ptr, size_t input_size) {
+  input_ = reinterpret_cast<const float *const *>(input_ptr); // NOLINT(performance-no-int-to-ptr)
+  input_size_ = input_size;
+  output_size_ = rubber_band_->getOutputFrame(input_size);
+  rendered_ = false;
+  // The parallel render studies every segment itself and only knows a constant ratio
+  streaming_ = thread_count_ == 1 || !key_frames_.empty();
+  if (streaming_) {
+    rubber_band_->setInput(input_, input_size_);
   }
+  return output_size_;
+}
 
+size_t RubberBandProcessor::setInterleavedBuffer(uintptr_t input_ptr, size_t input_size, SampleFormat sample_format) {
+  input_ = nullptr;
+  input_size_ = input_size;
+  output_size_ = rubber_band_->getOutputFrame(input_size);
+  rendered_ = false;
+  streaming_ = true;
+  rubber_band_->setInput(reinterpret_cast<const void *>(input_ptr), sample_format, input_size); // NOLINT(performance-no-int-to-ptr)
   return output_size_;
 }
 
@@ -64,31 +59,32 @@ size_t RubberBandProcessor::getOutputSize() const {
   return output_size_;
 }
 
-size_t RubberBandProcessor::retrieve(uintptr_t output_ptr, size_t desired_output_size) {
-  auto output = reinterpret_cast<float **>(output_ptr); // = new float*[channel_count];
-  auto channel_count = stretcher_->getChannelCount();
-  const auto output_size = std::min(desired_output_size, output_size_);
-
-  for (int channel = 0; channel < channel_count; ++channel) {
-    for (int sample = 0; sample < output_size; sample++) {
-      output[channel][sample] = output_[channel][sample];
+size_t RubberBandProcessor::retrieve(uintptr_t output_ptr, size_t output_size) {
+  auto output = reinterpret_cast<float *const *>(output_ptr); // NOLINT(performance-no-int-to-ptr)
+  if (rendered_) {
+    return 0;
+  }
+  if (!streaming_) {
+    if (output_size >= output_size_) {
+      ParallelOfflineRubberBand parallel(sample_rate_, channel_count_, rubber_band_->getTimeRatio(),
+                                         rubber_band_->getPitchScale(), thread_count_);
+      rendered_ = true;
+      return parallel.render(input_, input_size_, output);
     }
+    rubber_band_->setInput(input_, input_size_);
+    streaming_ = true;
   }
-
-  return output_size;
+  return rubber_band_->render(output, 0, output_size);
 }
 
-void RubberBandProcessor::tryFetch() {
-  auto channel_count = stretcher_->getChannelCount();
-  auto available = stretcher_->available();
-  while (available > 0) {
-    size_t actual = stretcher_->retrieve(scratch_, available);
-    for (size_t channel = 0; channel < channel_count; ++channel) {
-      for (size_t sample; sample < actual; ++sample) {
-        output_[channel][sample] = scratch_[channel][sample];
-      }
-    }
-    output_fetched_counter_ += actual;
-    available = stretcher_->available();
+size_t RubberBandProcessor::retrieveInterleaved(uintptr_t output_ptr, size_t output_size, SampleFormat sample_format) {
+  auto output = reinterpret_cast<void *>(output_ptr); // NOLINT(performance-no-int-to-ptr)
+  if (rendered_) {
+    return 0;
   }
-}
\ No newline at end of file
+  if (!streaming_) {
+    rubber_band_->setInput(input_, input_size_);
+    streaming_ = true;
+  }
+  return rubber_band_->renderInterleaved(output, sample_format, output_size);
+}
@@ -5,9 +5,10 @@
 #ifndef RUBBERBAND_WEB_RUBBERBANDPROCESSOR_H
 #define RUBBERBAND_WEB_RUBBERBANDPROCESSOR_H
 
-#include <RubberBandStretcher.h>
-#include "../../lib/third-party/rubberband-3.0.0/src/common/RingBuffer.h"
-#include <queue>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include "OfflineRubberBand.h"
 
 class RubberBandProcessor {
  public:
@@ -18,25 +19,44 @@ class RubberBandProcessor {
 
   ~RubberBandProcessor();
 
+  // 1 (default) renders on the calling thread. Anything else renders segments in parallel (0 uses every core)
+  // when retrieve() asks for the whole output at once, see ParallelOfflineRubberBand. Builds without threads
+  // always render on the calling thread.
+  void setThreadCount(size_t thread_count);
+
+  // Anchors the output frame of an input frame for a variable tempo, call before setBuffer(). Key frames render
+  // with a single stretcher whatever the thread count, see OfflineRubberBand::setKeyFrameMap().
+  void addKeyFrame(size_t input_frame, size_t output_frame);
+
+  void clearKeyFrames();
+
+  // Studies the caller's planar input, which has to stay valid until everything has been retrieved
   size_t setBuffer(uintptr_t input_ptr, size_t input_size);
 
+  // Same for an interleaved buffer in sample_format, converted a chunk at a time while rendering. Renders with a
+  // single stretcher whatever the thread count.
+  size_t setInterleavedBuffer(uintptr_t input_ptr, size_t input_size, SampleFormat sample_format);
+
   [[nodiscard]] size_t getOutputSize() const;
 
+  // Renders the next output_size frames into the caller's planar output, continuing where the last call stopped
   size_t retrieve(uintptr_t output_ptr, size_t output_size);
 
- private:
-  void tryFetch();
+  // Same into an interleaved output in sample_format, renders with a single stretcher
+  size_t retrieveInterleaved(uintptr_t output_ptr, size_t output_size, SampleFormat sample_format);
 
-  float **input_;
+ private:
+  size_t sample_rate_;
+  size_t channel_count_;
+  size_t thread_count_ = 1;
+  std::map<size_t, size_t> key_frames_;
+  const float *const *input_ = nullptr;
   size_t input_size_ = 0;
-  size_t input_processed_counter_ = 0;
-  float **output_;
   size_t output_size_ = 0;
-  size_t output_fetched_counter_ = 0;
-
-  float** scratch_;
-
-  RubberBand::RubberBandStretcher *stretcher_;
+  // Whether rubber_band_ renders the input, and whether a parallel render already wrote all output
+  bool streaming_ = false;
+  bool rendered_ = false;
+  OfflineRubberBand *rubber_band_;
 };
 
 #endif //RUBBERBAND_WEB_RUBBERBANDPROCESSOR_H
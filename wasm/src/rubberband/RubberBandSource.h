@@ -5,7 +5,7 @@
 #ifndef WASM_SRC_RUBBERBANDSOURCE_H_
 #define WASM_SRC_RUBBERBANDSOURCE_H_
 
-#include <RubberBandStretcher.h>
+#include "OfflineRubberBand.h"
 #include "../PitchShiftSource.h"
 
 class RubberBandSource : PitchShiftSource {
@@ -21,25 +21,33 @@ class RubberBandSource : PitchShiftSource {
 
   size_t retrieve(uintptr_t output_ptr) override;
 
+  // setBuffer()/retrieve() for interleaved samples in sample_format, input is converted as it is rendered
+  void setInterleavedBuffer(uintptr_t input_ptr, size_t input_size, SampleFormat sample_format);
+
+  size_t retrieveInterleaved(uintptr_t output_ptr, SampleFormat sample_format);
+
+  // Continues playback at output_frame (at the current time ratio) after a short pre-roll, returns the new position
+  size_t seek(size_t output_frame) override;
+
+  // Output frame retrieve() returns next
+  [[nodiscard]] size_t getPosition() const override;
+
   [[nodiscard]] size_t getInputSize() const override;
 
   [[nodiscard]] size_t getOutputSize() const override;
 
+  // NaN and Inf samples processed as silence since the last setBuffer(), parameter change or seek
+  [[nodiscard]] size_t getNonFiniteSampleCount() const;
+
   size_t getSamplesAvailable() override;
 
   void reset() override;
  private:
-  void restart();
-  void process(size_t sample_size);
-
-  const float *const *input_;
-  size_t input_size_;
-  size_t output_size_;
-  size_t play_position_;
-  size_t pre_process_position_;
+  void restart(size_t input_position);
+  [[nodiscard]] size_t getInputPosition() const;
+
   size_t pre_process_size_;
-  float** process_buffer_;
-  RubberBand::RubberBandStretcher *stretcher_;
+  OfflineRubberBand *rubber_band_;
 
   static const size_t kRenderQuantumFrames = 128;
 };
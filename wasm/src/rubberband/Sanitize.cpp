@@ -0,0 +1,148 @@
+//
+// Copy kernels that replace NaN and Inf samples with silence on the way into the stretcher.
+//
+// A sample is NaN or Inf when all of its exponent bits are set. Testing the bits instead of comparing floats
+// keeps working under -ffast-math and vectorizes into a compare and a mask per four samples.
+//
+
+#include "Sanitize.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define SANITIZE_SIMD128 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SANITIZE_SSE2 1
+#endif
+
+static const uint32_t kExponentMask = 0x7F800000u;
+
+static bool isNonFinite(float sample) {
+  uint32_t bits;
+  std::memcpy(&bits, &sample, sizeof(bits));
+  return (bits & kExponentMask) == kExponentMask;
+}
+
+size_t findNonFiniteScalar(const float *source, size_t sample_count) {
+  size_t i = 0;
+  while (i < sample_count && !isNonFinite(source[i])) {
+    ++i;
+  }
+  return i;
+}
+
+size_t copySanitizedScalar(const float *source, float *destination, size_t sample_count) {
+  size_t count = 0;
+  for (size_t i = 0; i < sample_count; ++i) {
+    const bool bad = isNonFinite(source[i]);
+    count += bad;
+    destination[i] = bad ? 0.0f : source[i];
+  }
+  return count;
+}
+
+#if defined(SANITIZE_SIMD128)
+
+static v128_t badLanes(const float *source, v128_t exponent) {
+  return wasm_i32x4_eq(wasm_v128_and(wasm_v128_load(source), exponent), exponent);
+}
+
+// Skips blocks of 16 clean samples, the scalar loop finds the exact index
+static size_t findVector(const float *source, size_t sample_count) {
+  const v128_t exponent = wasm_i32x4_splat(static_cast<int32_t>(kExponentMask));
+  size_t i = 0;
+  for (; i + 16 <= sample_count; i += 16) {
+    const v128_t bad = wasm_v128_or(wasm_v128_or(badLanes(source + i, exponent), badLanes(source + i + 4, exponent)),
+                                    wasm_v128_or(badLanes(source + i + 8, exponent),
+                                                 badLanes(source + i + 12, exponent)));
+    if (wasm_v128_any_true(bad)) {
+      break;
+    }
+  }
+  return i;
+}
+
+// Lanes of bad are all ones (-1) where a sample is non-finite, subtracting them counts per lane
+static size_t copyVector(const float *source, float *destination, size_t sample_count, size_t &count) {
+  const v128_t exponent = wasm_i32x4_splat(static_cast<int32_t>(kExponentMask));
+  v128_t counter = wasm_i32x4_splat(0);
+  size_t i = 0;
+  for (; i + 4 <= sample_count; i += 4) {
+    const v128_t samples = wasm_v128_load(source + i);
+    const v128_t bad = wasm_i32x4_eq(wasm_v128_and(samples, exponent), exponent);
+    wasm_v128_store(destination + i, wasm_v128_andnot(samples, bad));
+    counter = wasm_i32x4_sub(counter, bad);
+  }
+  count = static_cast<size_t>(wasm_i32x4_extract_lane(counter, 0)) + wasm_i32x4_extract_lane(counter, 1) +
+      wasm_i32x4_extract_lane(counter, 2) + wasm_i32x4_extract_lane(counter, 3);
+  return i;
+}
+
+#elif defined(SANITIZE_SSE2)
+
+static __m128i badLanes(const float *source, __m128i exponent) {
+  const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source));
+  return _mm_cmpeq_epi32(_mm_and_si128(samples, exponent), exponent);
+}
+
+static size_t findVector(const float *source, size_t sample_count) {
+  const __m128i exponent = _mm_set1_epi32(static_cast<int32_t>(kExponentMask));
+  size_t i = 0;
+  for (; i + 16 <= sample_count; i += 16) {
+    const __m128i bad = _mm_or_si128(_mm_or_si128(badLanes(source + i, exponent), badLanes(source + i + 4, exponent)),
+                                     _mm_or_si128(badLanes(source + i + 8, exponent),
+                                                  badLanes(source + i + 12, exponent)));
+    if (_mm_movemask_epi8(bad) != 0) {
+      break;
+    }
+  }
+  return i;
+}
+
+static size_t copyVector(const float *source, float *destination, size_t sample_count, size_t &count) {
+  const __m128i exponent = _mm_set1_epi32(static_cast<int32_t>(kExponentMask));
+  __m128i counter = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 4 <= sample_count; i += 4) {
+    const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i));
+    const __m128i bad = _mm_cmpeq_epi32(_mm_and_si128(samples, exponent), exponent);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm_andnot_si128(bad, samples));
+    counter = _mm_sub_epi32(counter, bad);
+  }
+  alignas(16) uint32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i *>(lanes), counter);
+  count = static_cast<size_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+  return i;
+}
+
+#endif
+
+size_t findNonFinite(const float *source, size_t sample_count) {
+  size_t done = 0;
+#if defined(SANITIZE_SIMD128) || defined(SANITIZE_SSE2)
+  done = findVector(source, sample_count);
+#endif
+  return done + findNonFiniteScalar(source + done, sample_count - done);
+}
+
+size_t copySanitized(const float *source, float *destination, size_t sample_count) {
+  size_t count = 0;
+  size_t done = 0;
+#if defined(SANITIZE_SIMD128) || defined(SANITIZE_SSE2)
+  done = copyVector(source, destination, sample_count, count);
+#endif
+  return count + copySanitizedScalar(source + done, destination + done, sample_count - done);
+}
+
+const char *getSanitizeKernelName() {
+#if defined(SANITIZE_SIMD128)
+  return "simd128";
+#elif defined(SANITIZE_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
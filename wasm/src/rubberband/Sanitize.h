@@ -0,0 +1,25 @@
+//
+// Copy kernels that replace NaN and Inf samples with silence on the way into the stretcher.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_SANITIZE_H_
+#define WASM_SRC_RUBBERBAND_SANITIZE_H_
+
+#include <cstddef>
+
+// Returns the index of the first NaN or Inf sample, sample_count when there is none
+size_t findNonFinite(const float *source, size_t sample_count);
+
+// Copies sample_count samples from source to destination with NaN and Inf replaced by 0, returns the samples
+// replaced. source and destination may be the same buffer.
+size_t copySanitized(const float *source, float *destination, size_t sample_count);
+
+// Plain loops without vectorization, used as reference by tests and benchmarks
+size_t findNonFiniteScalar(const float *source, size_t sample_count);
+
+size_t copySanitizedScalar(const float *source, float *destination, size_t sample_count);
+
+// Name of the instruction set the kernels above use (scalar, sse2, simd128)
+const char *getSanitizeKernelName();
+
+#endif //WASM_SRC_RUBBERBAND_SANITIZE_H_
@@ -0,0 +1,42 @@
+//
+// Sanitize kernels against the scalar reference, for every kind of non-finite value and odd lengths.
+//
+#include <gtest/gtest.h>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "Sanitize.h"
+
+TEST(Sanitize, MatchesScalar) {
+  const float bad_values[] = {std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN(),
+                              std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+  for (size_t sample_count : {0, 1, 3, 4, 5, 8, 31, 129, 1024}) {
+    std::vector<float> source(sample_count);
+    size_t bad_count = 0;
+    for (size_t i = 0; i < sample_count; ++i) {
+      if (i % 7 == 3) {
+        source[i] = bad_values[i % 4];
+        ++bad_count;
+      } else {
+        // Largest finite values and denormals are kept
+        source[i] = i % 5 == 0 ? std::numeric_limits<float>::max() : std::numeric_limits<float>::denorm_min() * i;
+      }
+    }
+    std::vector<float> expected(sample_count, -1.0f);
+    std::vector<float> actual(sample_count, -1.0f);
+    EXPECT_EQ(copySanitizedScalar(source.data(), expected.data(), sample_count), bad_count);
+    EXPECT_EQ(copySanitized(source.data(), actual.data(), sample_count), bad_count) << sample_count;
+    EXPECT_EQ(findNonFinite(source.data(), sample_count), std::min<size_t>(3, sample_count)) << sample_count;
+    EXPECT_EQ(findNonFinite(source.data() + 4, sample_count - std::min<size_t>(4, sample_count)),
+              findNonFiniteScalar(source.data() + 4, sample_count - std::min<size_t>(4, sample_count)));
+    EXPECT_EQ(actual, expected) << sample_count;
+    for (size_t i = 0; i < sample_count; ++i) {
+      ASSERT_TRUE(std::isfinite(actual[i])) << i;
+    }
+
+    // In place
+    EXPECT_EQ(copySanitized(source.data(), source.data(), sample_count), bad_count);
+    EXPECT_EQ(source, expected);
+  }
+}
@@ -0,0 +1,93 @@
+//
+// Audio ring living in WASM linear memory, so JS can attach views instead of going through emscripten::val.
+//
+
+#include "SharedAudioRing.h"
+#include "Interleave.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t), "Control words must map onto an Int32Array");
+
+SharedAudioRing::SharedAudioRing(size_t frame_count, size_t channel_count) :
+    frame_count_(frame_count),
+    channel_count_(channel_count) {
+  if (frame_count < 2) {
+    throw std::range_error("Ring size has to be at least 2 frames");
+  }
+  if (channel_count <= 0) {
+    throw std::range_error("Channel count has to be greater than 0");
+  }
+  audio_ = new float[frame_count_ * channel_count_];
+  std::fill(audio_, audio_ + frame_count_ * channel_count_, 0.0f);
+  control_ = new std::atomic<int32_t>[kControlSize];
+  reset();
+}
+
+SharedAudioRing::~SharedAudioRing() {
+  delete[] audio_;
+  delete[] control_;
+}
+
+uintptr_t SharedAudioRing::getAudioPtr() const {
+  return reinterpret_cast<uintptr_t>(audio_);
+}
+
+uintptr_t SharedAudioRing::getControlPtr() const {
+  return reinterpret_cast<uintptr_t>(control_);
+}
+
+size_t SharedAudioRing::getFrameCount() const {
+  return frame_count_;
+}
+
+size_t SharedAudioRing::getReadSpace() const {
+  const int32_t write = control_[kWritePtr].load(std::memory_order_acquire);
+  const int32_t read = control_[kReadPtr].load(std::memory_order_relaxed);
+  int32_t available = write - read;
+  if (available < 0) available += static_cast<int32_t>(frame_count_);
+  return available;
+}
+
+size_t SharedAudioRing::getWriteSpace() const {
+  const int32_t write = control_[kWritePtr].load(std::memory_order_relaxed);
+  const int32_t read = control_[kReadPtr].load(std::memory_order_acquire);
+  int32_t space = read - write - 1;
+  if (space < 0) space += static_cast<int32_t>(frame_count_);
+  return space;
+}
+
+size_t SharedAudioRing::read(float *const *output, size_t frame_count) {
+  const size_t to_read = std::min(frame_count, getReadSpace());
+  const size_t position = control_[kReadPtr].load(std::memory_order_relaxed);
+  // Up to the end of the ring, then the wrapped part from its start
+  const size_t first = std::min(to_read, frame_count_ - position);
+  deinterleave(audio_ + position * channel_count_, output, 0, channel_count_, first);
+  deinterleave(audio_, output, first, channel_count_, to_read - first);
+  control_[kReadPtr].store(static_cast<int32_t>((position + to_read) % frame_count_), std::memory_order_release);
+  return to_read;
+}
+
+size_t SharedAudioRing::skip(size_t frame_count) {
+  const size_t to_skip = std::min(frame_count, getReadSpace());
+  const size_t position = control_[kReadPtr].load(std::memory_order_relaxed);
+  control_[kReadPtr].store(static_cast<int32_t>((position + to_skip) % frame_count_), std::memory_order_release);
+  return to_skip;
+}
+
+size_t SharedAudioRing::write(const float *const *input, size_t frame_count) {
+  const size_t to_write = std::min(frame_count, getWriteSpace());
+  const size_t position = control_[kWritePtr].load(std::memory_order_relaxed);
+  const size_t first = std::min(to_write, frame_count_ - position);
+  interleave(input, 0, audio_ + position * channel_count_, channel_count_, first);
+  interleave(input, first, audio_, channel_count_, to_write - first);
+  control_[kWritePtr].store(static_cast<int32_t>((position + to_write) % frame_count_), std::memory_order_release);
+  return to_write;
+}
+
+void SharedAudioRing::reset() {
+  for (size_t i = 0; i < kControlSize; ++i) {
+    control_[i].store(0, std::memory_order_relaxed);
+  }
+}
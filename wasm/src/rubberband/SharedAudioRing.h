@@ -0,0 +1,44 @@
+//
+// Audio ring living in WASM linear memory, so JS can attach views instead of going through emscripten::val.
+//
+
+#ifndef WASM_SRC_RUBBERBAND_SHAREDAUDIORING_H_
+#define WASM_SRC_RUBBERBAND_SHAREDAUDIORING_H_
+
+#include <atomic>
+#include <cstdint>
+#include "AudioRing.h"
+
+class SharedAudioRing : public AudioRing {
+ public:
+  SharedAudioRing(size_t frame_count, size_t channel_count);
+  ~SharedAudioRing() override;
+
+  // Byte offset of the interleaved Float32 audio data (frame_count * channel_count floats)
+  [[nodiscard]] uintptr_t getAudioPtr() const;
+
+  // Byte offset of the Int32 control words (kControlSize entries)
+  [[nodiscard]] uintptr_t getControlPtr() const;
+
+  [[nodiscard]] size_t getFrameCount() const override;
+
+  [[nodiscard]] size_t getReadSpace() const override;
+
+  [[nodiscard]] size_t getWriteSpace() const override;
+
+  size_t read(float *const *output, size_t frame_count) override;
+
+  size_t skip(size_t frame_count) override;
+
+  size_t write(const float *const *input, size_t frame_count) override;
+
+  void reset();
+
+ private:
+  float *audio_;
+  std::atomic<int32_t> *control_;
+  size_t frame_count_;
+  size_t channel_count_;
+};
+
+#endif //WASM_SRC_RUBBERBAND_SHAREDAUDIORING_H_